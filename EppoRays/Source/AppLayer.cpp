@@ -5,20 +5,24 @@
 
 void AppLayer::OnAttach()
 {
+	Scene scene;
+	std::vector<Material>& materials = scene.EditMaterials();
+	std::vector<Sphere>& spheres = scene.EditSpheres();
+
 	{
-		Material& material = m_Scene.m_Materials.emplace_back();
+		Material& material = materials.emplace_back();
 		material.Albedo = glm::vec3(0.2f, 1.0f, 0.2f);
 		material.Roughness = 0.02f;
 	}
 
 	{
-		Material& material = m_Scene.m_Materials.emplace_back();
+		Material& material = materials.emplace_back();
 		material.Albedo = glm::vec3(0.2f, 0.6f, 0.8f);
 		material.Roughness = 0.4f;
 	}
 
 	{
-		Material& material = m_Scene.m_Materials.emplace_back();
+		Material& material = materials.emplace_back();
 		material.Albedo = glm::vec3(1.0f, 1.0f, 1.0f);
 		material.Roughness = 1.00f;
 		material.Emission = glm::vec3(1.0f, 1.0f, 1.0f);
@@ -26,41 +30,64 @@ void AppLayer::OnAttach()
 	}
 
 	{
-		Sphere& sphere = m_Scene.m_Spheres.emplace_back();
+		Sphere& sphere = spheres.emplace_back();
 		sphere.Position = glm::vec3(0.0f, 1.0f, 0.0f);
 		sphere.Radius = 1.0f;
 		sphere.MaterialIndex = 0;
 	}
 
 	{
-		Sphere& sphere = m_Scene.m_Spheres.emplace_back();
+		Sphere& sphere = spheres.emplace_back();
 		sphere.Position = glm::vec3(0.0f, -50.0f, 0.0f);
 		sphere.Radius = 50.0f;
 		sphere.MaterialIndex = 1;
 	}
 
 	{
-		Sphere& sphere = m_Scene.m_Spheres.emplace_back();
+		Sphere& sphere = spheres.emplace_back();
 		sphere.Position = glm::vec3(0.0f, 150.0f, 0.0f);
 		sphere.Radius = 100.0f;
 		sphere.MaterialIndex = 2;
 	}
 
 	{
-		Sphere& sphere = m_Scene.m_Spheres.emplace_back();
+		Sphere& sphere = spheres.emplace_back();
 		sphere.Position = glm::vec3(-3.0f, 1.5f, 0.0f);
 		sphere.Radius = 1.5f;
 		sphere.MaterialIndex = 0;
 	}
 
+	uint32_t firstSmallSphere = (uint32_t)spheres.size();
 	for (uint32_t i = 0; i < 5; i++)
 	{
-		Sphere& sphere = m_Scene.m_Spheres.emplace_back();
+		Sphere& sphere = spheres.emplace_back();
 		sphere.Position = glm::vec3(1.0f - i, 0.3f, -cos(-2.0f + (float)i) - 5.0f);
 		sphere.Radius = 0.5f;
 		sphere.MaterialIndex = Eppo::Random::UInt32(0, 1);
 	}
 
+	// Turntable of the small spheres around the center sphere
+	for (uint32_t frame = 0; frame <= 120; frame++)
+	{
+		float angle = glm::radians(360.0f * (float)frame / 120.0f);
+
+		for (uint32_t i = firstSmallSphere; i < spheres.size(); i++)
+		{
+			const Sphere& sphere = spheres[i];
+
+			SphereKeyframe keyframe;
+			keyframe.Frame = (float)frame;
+			keyframe.Position.x = sphere.Position.x * cos(angle) - sphere.Position.z * sin(angle);
+			keyframe.Position.y = sphere.Position.y;
+			keyframe.Position.z = sphere.Position.x * sin(angle) + sphere.Position.z * cos(angle);
+			keyframe.Radius = sphere.Radius;
+
+			m_Animation.AddKeyframe(i, keyframe);
+		}
+	}
+
+	m_Scene.Publish(std::move(scene));
+
 	m_Camera.SetPosition(glm::vec3(5.9f, 6.5f, -0.3f));
 	m_Camera.SetDirection(glm::vec3(-0.8f, -0.6f, -0.2f));
 
@@ -76,8 +103,32 @@ void AppLayer::OnUpdate(float timestep)
 		m_Renderer.ResetFrameIndex();
 
 	Timer renderTimer;
-	m_Renderer.Render(m_Scene, m_Camera, Renderer::RenderMode::CpuMT);
+	bool renderingTurnaround = !m_TurnaroundRenderViews.empty();
+	bool renderingSequence = m_Sequence.IsActive();
+	if (renderingTurnaround)
+	{
+		RenderTurnaroundPass();
+	} else if (renderingSequence)
+	{
+		uint32_t frame = m_Sequence.GetCurrentFrame();
+		bool framesLeft = m_Sequence.RenderNextFrame(m_Renderer, m_Camera, Renderer::RenderMode::CpuMT);
+
+		if (m_WriteSequenceFrames)
+		{
+			char filepath[300];
+			snprintf(filepath, sizeof(filepath), "%s_%04u%s", m_OutputPath, frame, ImageWriter::GetExtension(m_OutputFormat));
+			m_ImageWriter.Write(m_Renderer.GetRenderTarget(), filepath, m_OutputFormat);
+		}
+
+		// The viewport starts over from the live scene instead of adding to the last animated frame
+		if (!framesLeft)
+			m_Renderer.ResetFrameIndex();
+	} else
+		m_Renderer.Render(m_Scene, m_Camera, Renderer::RenderMode::CpuMT);
 	m_LastRenderTime = renderTimer.GetElapsedMicroseconds();
+
+	if (!renderingTurnaround && !renderingSequence)
+		m_Renderer.OnFrameTime(m_LastRenderTime);
 }
 
 void AppLayer::OnUIRender()
@@ -91,8 +142,25 @@ void AppLayer::OnUIRender()
 
 	const auto& image = m_Renderer.GetImage();
 	if (image)
+	{
+		ImVec2 imagePosition = ImGui::GetCursorScreenPos();
 		ImGui::Image((ImTextureID)image->GetRendererID(), ImVec2((float)image->GetWidth(), (float)image->GetHeight()), ImVec2(0, 1), ImVec2(1, 0));
 
+		// The image is displayed flipped, so the cursor position needs to be flipped as well
+		if (ImGui::IsItemHovered())
+		{
+			ImVec2 mousePosition = ImGui::GetMousePos();
+			uint32_t x = (uint32_t)std::max(mousePosition.x - imagePosition.x, 0.0f);
+			uint32_t y = (uint32_t)std::max(mousePosition.y - imagePosition.y, 0.0f);
+
+			if (x < image->GetWidth() && y < image->GetHeight())
+				m_Renderer.SetFocusPoint(x, image->GetHeight() - 1 - y);
+		} else
+		{
+			m_Renderer.ClearFocusPoint();
+		}
+	}
+
 	ImGui::End();
 	ImGui::PopStyleVar();
 
@@ -110,6 +178,12 @@ void AppLayer::OnUIRender()
 
 	ImGui::Checkbox("Accumulate", &settings.Accumulate);
 
+	if (ImGui::SliderInt("Bounces", (int*)&settings.Bounces, 1, 8, "%d", ImGuiSliderFlags_AlwaysClamp))
+		m_Renderer.ResetFrameIndex();
+
+	ImGui::SliderInt("Samples per pass", (int*)&settings.SamplesPerPass, 1, 64, "%d", ImGuiSliderFlags_AlwaysClamp);
+	ImGui::SliderInt("Display interval", (int*)&settings.DisplayInterval, 1, 64, "%d", ImGuiSliderFlags_AlwaysClamp);
+
 	bool accumulate = m_Renderer.GetSettings().Accumulate;
 	if (accumulate)
 		ImGui::Text("Frames accumulated: %d", m_Renderer.GetFrameIndex());
@@ -117,46 +191,255 @@ void AppLayer::OnUIRender()
 	if (ImGui::Button("Reset"))
 		m_Renderer.ResetFrameIndex();
 
+	if (ImGui::CollapsingHeader("Frame budget"))
+	{
+		ImGui::Checkbox("Hold target frame time", &settings.UseFrameBudget);
+		ImGui::DragFloat("Target render time (ms)", &settings.TargetFrameTime, 0.1f, 1.0f, 1000.0f);
+
+		if (settings.UseFrameBudget)
+			ImGui::Text("Tiles: %d, samples per pass: %d", m_Renderer.GetPassTileCount(), m_Renderer.GetPassSamples());
+	}
+
+	if (ImGui::CollapsingHeader("Level of detail"))
+	{
+		bool lodChanged = false;
+		if (ImGui::Checkbox("Use proxies", &settings.UseLOD)) lodChanged = true;
+		if (ImGui::DragFloat("Threshold", &settings.LODThreshold, 0.01f, 0.0f, 100.0f)) lodChanged = true;
+		if (ImGui::SliderInt("From bounce", (int*)&settings.LODMinBounce, 0, 8, "%d", ImGuiSliderFlags_AlwaysClamp)) lodChanged = true;
+
+		if (lodChanged)
+			m_Renderer.ResetFrameIndex();
+	}
+
+	if (ImGui::CollapsingHeader("Path guiding"))
+	{
+		bool guidingChanged = false;
+		if (ImGui::Checkbox("Use path guiding", &settings.UsePathGuiding)) guidingChanged = true;
+		if (ImGui::SliderFloat("Guided fraction", &settings.GuidingFraction, 0.0f, 0.9f)) guidingChanged = true;
+		if (ImGui::SliderFloat("Min roughness", &settings.GuidingMinRoughness, 0.0f, 1.0f)) guidingChanged = true;
+		ImGui::Text("Cells: %u", m_Renderer.GetPathGuideCellCount());
+
+		if (guidingChanged)
+			m_Renderer.ResetFrameIndex();
+	}
+
+	if (ImGui::CollapsingHeader("Render region"))
+	{
+		ImGui::SliderInt("Tile size", (int*)&settings.TileSize, 8, 256, "%d", ImGuiSliderFlags_AlwaysClamp);
+
+		if (ImGui::Checkbox("Crop", &settings.UseCropRegion))
+			m_Renderer.ResetFrameIndex();
+
+		if (settings.UseCropRegion && ImGui::DragInt4("Crop region", (int*)&settings.CropRegion, 1.0f, 0, 16384, "%d", ImGuiSliderFlags_AlwaysClamp))
+			m_Renderer.ResetFrameIndex();
+
+		ImGui::Checkbox("Prioritize cursor region", &settings.PrioritizeFocus);
+		ImGui::SliderInt("Cursor region samples", (int*)&settings.FocusSampleScale, 1, 16, "%d", ImGuiSliderFlags_AlwaysClamp);
+
+		if (ImGui::Checkbox("Cursor region only", &settings.FocusRegionOnly))
+			m_Renderer.ResetFrameIndex();
+
+		ImGui::DragInt("Cursor radius", (int*)&settings.FocusRadius, 1.0f, 8, 4096, "%d", ImGuiSliderFlags_AlwaysClamp);
+	}
+
 	ImGui::Separator();
 
-	bool changed = false;
+	// Widgets read the current version and collect the elements they changed. Those are applied as
+	// one edit, which only copies the array they belong to.
+	SceneStore::Snapshot current = m_Scene.Acquire();
+	std::vector<std::pair<uint32_t, Material>> materialEdits;
+	std::vector<std::pair<uint32_t, Sphere>> sphereEdits;
+
 	if (ImGui::CollapsingHeader("Materials", ImGuiTreeNodeFlags_DefaultOpen))
 	{
-		for (uint32_t i = 0; i < m_Scene.m_Materials.size(); i++)
+		for (uint32_t i = 0; i < current->m_Materials->size(); i++)
 		{
-			Material& material = m_Scene.m_Materials[i];
+			Material material = (*current->m_Materials)[i];
 
 			if (i > 0)
 				ImGui::Separator();
 
+			bool changed = false;
 			ImGui::PushID(i);
 			if (ImGui::ColorEdit3("Albedo", glm::value_ptr(material.Albedo))) changed = true;
 			if (ImGui::ColorEdit3("Emission", glm::value_ptr(material.Emission))) changed = true;
 			if (ImGui::DragFloat("Emission Power", &material.EmissionPower, 0.01f, 0.0f, 1000.0f)) changed = true;
 			if (ImGui::DragFloat("Roughness", &material.Roughness, 0.01f, 0.0f, 1.0f)) changed = true;
 			ImGui::PopID();
+
+			if (changed)
+				materialEdits.emplace_back(i, material);
 		}
 	}
 
 	if (ImGui::CollapsingHeader("Spheres", ImGuiTreeNodeFlags_DefaultOpen))
 	{
-		for (uint32_t i = 0; i < m_Scene.m_Spheres.size(); i++)
+		for (uint32_t i = 0; i < current->m_Spheres->size(); i++)
 		{
-			Sphere& sphere = m_Scene.m_Spheres[i];
+			Sphere sphere = (*current->m_Spheres)[i];
 
 			if (i > 0)
 				ImGui::Separator();
 
+			bool changed = false;
 			ImGui::PushID(i);
 			if (ImGui::DragFloat3("Position", glm::value_ptr(sphere.Position), 0.1f)) changed = true;
 			if (ImGui::DragFloat("Radius", &sphere.Radius)) changed = true;
-			if (ImGui::DragInt("Material index", (int*)&sphere.MaterialIndex, 1.0f, 0, (int)m_Scene.m_Materials.size() - 1)) changed = true;
+			if (ImGui::DragInt("Material index", (int*)&sphere.MaterialIndex, 1.0f, 0, (int)current->m_Materials->size() - 1, "%d", ImGuiSliderFlags_AlwaysClamp)) changed = true;
 			ImGui::PopID();
+
+			if (changed)
+				sphereEdits.emplace_back(i, sphere);
 		}
 	}
 
-	if (changed)
+	current.Release();
+
+	if (!materialEdits.empty() || !sphereEdits.empty())
+	{
+		m_Scene.Edit([&](Scene& scene)
+		{
+			for (const auto& [index, material] : materialEdits)
+				scene.EditMaterials()[index] = material;
+
+			for (const auto& [index, sphere] : sphereEdits)
+				scene.EditSpheres()[index] = sphere;
+		});
+
 		m_Renderer.ResetFrameIndex();
+	}
+
+	if (ImGui::CollapsingHeader("Output"))
+	{
+		ImGui::InputText("Path", m_OutputPath, sizeof(m_OutputPath));
+
+		const char* formats[] = { "PNG (8-bit)", "PNG (16-bit)", "EXR (float)", "Raw (float)" };
+		ImGui::Combo("Format", (int*)&m_OutputFormat, formats, IM_ARRAYSIZE(formats));
+
+		if (ImGui::Button("Save image"))
+			m_ImageWriter.Write(m_Renderer.GetRenderTarget(), std::string(m_OutputPath) + ImageWriter::GetExtension(m_OutputFormat), m_OutputFormat);
+
+		if (m_ImageWriter.GetPendingWrites() > 0)
+			ImGui::Text("Pending writes: %d", m_ImageWriter.GetPendingWrites());
+	}
+
+	if (ImGui::CollapsingHeader("Turnaround"))
+	{
+		if (!m_TurnaroundRenderViews.empty())
+		{
+			ImGui::Text("Samples: %d / %d", m_TurnaroundSamplesDone, m_TurnaroundSamples);
+
+			if (ImGui::Button("Stop turnaround"))
+			{
+				m_TurnaroundRenderViews.clear();
+				m_TurnaroundCameras.clear();
+				m_TurnaroundTargets.clear();
+			}
+		} else
+		{
+			ImGui::DragInt("Views", (int*)&m_TurnaroundViews, 1.0f, 1, 64, "%d", ImGuiSliderFlags_AlwaysClamp);
+			ImGui::DragInt("View size", (int*)&m_TurnaroundSize, 1.0f, 16, 8192, "%d", ImGuiSliderFlags_AlwaysClamp);
+			ImGui::DragInt("Samples per view", (int*)&m_TurnaroundSamples, 1.0f, 1, 4096, "%d", ImGuiSliderFlags_AlwaysClamp);
+
+			if (ImGui::Button("Render turnaround"))
+				BeginTurnaround();
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Sequence"))
+	{
+		ImGui::DragInt("First frame", (int*)&m_SequenceFirstFrame, 1.0f, 0, (int)m_Animation.GetLastFrame(), "%d", ImGuiSliderFlags_AlwaysClamp);
+		ImGui::DragInt("Last frame", (int*)&m_SequenceLastFrame, 1.0f, (int)m_SequenceFirstFrame, (int)m_Animation.GetLastFrame(), "%d", ImGuiSliderFlags_AlwaysClamp);
+
+		int samplesPerFrame = (int)m_Sequence.GetSamplesPerFrame();
+		if (ImGui::DragInt("Samples per frame", &samplesPerFrame, 1.0f, 1, 4096, "%d", ImGuiSliderFlags_AlwaysClamp))
+			m_Sequence.SetSamplesPerFrame((uint32_t)samplesPerFrame);
+
+		ImGui::Checkbox("Write frames to output path", &m_WriteSequenceFrames);
+
+		if (m_Sequence.IsActive())
+		{
+			ImGui::Text("Frame: %d / %d", m_Sequence.GetCurrentFrame(), m_Sequence.GetLastFrame());
+
+			if (ImGui::Button("Stop"))
+			{
+				m_Sequence.Cancel();
+				m_Renderer.ResetFrameIndex();
+			}
+		} else if (ImGui::Button("Render sequence"))
+		{
+			m_Sequence.Begin(*m_Scene.Acquire(), m_Animation, m_SequenceFirstFrame, m_SequenceLastFrame);
+		}
+	}
 
 	ImGui::End();
 }
+
+void AppLayer::BeginTurnaround()
+{
+	// Views orbit around the center sphere, starting from the current camera position
+	constexpr glm::vec3 center(0.0f, 1.0f, 0.0f);
+	glm::vec3 offset = m_Camera.GetPosition() - center;
+
+	m_TurnaroundCameras.clear();
+	m_TurnaroundTargets.assign(m_TurnaroundViews, RenderTarget());
+	m_TurnaroundRenderViews.clear();
+	m_TurnaroundSamplesDone = 0;
+
+	// Views point into both arrays, so they may not grow after this
+	m_TurnaroundCameras.reserve(m_TurnaroundViews);
+	m_TurnaroundRenderViews.reserve(m_TurnaroundViews);
+
+	for (uint32_t i = 0; i < m_TurnaroundViews; i++)
+	{
+		float angle = glm::radians(360.0f * (float)i / (float)m_TurnaroundViews);
+
+		glm::vec3 position = center;
+		position.x += offset.x * cos(angle) - offset.z * sin(angle);
+		position.y += offset.y;
+		position.z += offset.x * sin(angle) + offset.z * cos(angle);
+
+		Camera& camera = m_TurnaroundCameras.emplace_back(45.0f, 0.1f, 10000.0f);
+		camera.OnResize(m_TurnaroundSize, m_TurnaroundSize);
+		camera.SetPosition(position);
+		camera.SetDirection(glm::normalize(center - position));
+
+		m_TurnaroundTargets[i].Resize(m_TurnaroundSize, m_TurnaroundSize);
+		m_TurnaroundRenderViews.push_back({ &camera, &m_TurnaroundTargets[i] });
+	}
+}
+
+void AppLayer::RenderTurnaroundPass()
+{
+	// Passes take the interactive samples per pass, the views keep accumulating until they are done
+	auto& settings = m_Renderer.GetSettings();
+	bool accumulate = settings.Accumulate;
+	uint32_t samplesPerPass = settings.SamplesPerPass;
+
+	uint32_t passSamples = std::max(samplesPerPass, 1u);
+	if (settings.UsePathGuiding)
+		passSamples = std::min(passSamples, std::max(m_TurnaroundSamples / Renderer::GuidedPassCount, 1u));
+
+	settings.Accumulate = true;
+	settings.SamplesPerPass = std::min(m_TurnaroundSamples - m_TurnaroundSamplesDone, passSamples);
+	m_Renderer.RenderViews(m_Scene, m_TurnaroundRenderViews);
+	m_TurnaroundSamplesDone += settings.SamplesPerPass;
+
+	settings.Accumulate = accumulate;
+	settings.SamplesPerPass = samplesPerPass;
+
+	if (m_TurnaroundSamplesDone < m_TurnaroundSamples)
+		return;
+
+	for (uint32_t i = 0; i < m_TurnaroundTargets.size(); i++)
+	{
+		char filepath[300];
+		snprintf(filepath, sizeof(filepath), "%s_view%02u%s", m_OutputPath, i, ImageWriter::GetExtension(m_OutputFormat));
+		m_ImageWriter.Write(m_TurnaroundTargets[i], filepath, m_OutputFormat);
+	}
+
+	// The writer took its own copy of every target
+	m_TurnaroundRenderViews.clear();
+	m_TurnaroundCameras.clear();
+	m_TurnaroundTargets.clear();
+}
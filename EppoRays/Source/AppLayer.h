@@ -2,14 +2,18 @@
 
 #include <EppoCore.h>
 #include "RT/Camera.h"
+#include "RT/ImageWriter.h"
 #include "RT/Renderer.h"
+#include "RT/Sequence.h"
 
 using namespace Eppo;
 
 class AppLayer : public Layer
 {
 public:
-	AppLayer() = default;
+	AppLayer()
+		: m_Sequence(m_Renderer.GetThreadPool())
+	{}
 	~AppLayer() override = default;
 
 	void OnAttach() override;
@@ -17,11 +21,35 @@ public:
 	void OnUpdate(float timestep) override;
 	void OnUIRender() override;
 
+private:
+	void BeginTurnaround();
+	void RenderTurnaroundPass();
+
 private:
 	Camera m_Camera = Camera(45.0f, 0.1f, 10000.0f);
-	Scene m_Scene;
+	SceneStore m_Scene;
 	Renderer m_Renderer;
 
+	Animation m_Animation;
+	SequenceRenderer m_Sequence;
+	uint32_t m_SequenceFirstFrame = 0;
+	uint32_t m_SequenceLastFrame = 120;
+	bool m_WriteSequenceFrames = false;
+
+	ImageWriter m_ImageWriter;
+	ImageFormat m_OutputFormat = ImageFormat::PNG;
+	char m_OutputPath[256] = "Output/render";
+
+	uint32_t m_TurnaroundViews = 12;
+	uint32_t m_TurnaroundSize = 512;
+	uint32_t m_TurnaroundSamples = 64;
+
+	// A turnaround takes one pass per frame instead of the viewport, so the editor stays responsive
+	std::vector<Camera> m_TurnaroundCameras;
+	std::vector<RenderTarget> m_TurnaroundTargets;
+	std::vector<Renderer::RenderView> m_TurnaroundRenderViews;
+	uint32_t m_TurnaroundSamplesDone = 0;
+
 	uint32_t m_ViewportWidth = 0;
 	uint32_t m_ViewportHeight = 0;
 
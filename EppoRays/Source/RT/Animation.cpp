@@ -0,0 +1,91 @@
+#include "Animation.h"
+
+#include <algorithm>
+
+void Animation::AddKeyframe(uint32_t sphereIndex, const SphereKeyframe& keyframe)
+{
+	auto it = std::find_if(m_Tracks.begin(), m_Tracks.end(), [sphereIndex](const Track& track) { return track.SphereIndex == sphereIndex; });
+	if (it == m_Tracks.end())
+	{
+		it = m_Tracks.emplace(m_Tracks.end());
+		it->SphereIndex = sphereIndex;
+	}
+
+	// Keep keyframes sorted so we can binary search them during evaluation
+	auto& keyframes = it->Keyframes;
+	auto position = std::upper_bound(keyframes.begin(), keyframes.end(), keyframe.Frame, [](float frame, const SphereKeyframe& other) { return frame < other.Frame; });
+	keyframes.insert(position, keyframe);
+
+	if (m_Tracks.size() == 1 && keyframes.size() == 1)
+	{
+		m_FirstFrame = keyframe.Frame;
+		m_LastFrame = keyframe.Frame;
+	} else
+	{
+		m_FirstFrame = std::min(m_FirstFrame, keyframe.Frame);
+		m_LastFrame = std::max(m_LastFrame, keyframe.Frame);
+	}
+}
+
+void Animation::Clear()
+{
+	m_Tracks.clear();
+	m_FirstFrame = 0.0f;
+	m_LastFrame = 0.0f;
+}
+
+void Animation::Evaluate(float frame, const Scene& scene, std::vector<SphereDelta>& deltas) const
+{
+	deltas.clear();
+
+	for (const auto& track : m_Tracks)
+	{
+		if (track.Keyframes.empty() || track.SphereIndex >= scene.m_Spheres->size())
+			continue;
+
+		const auto& keyframes = track.Keyframes;
+
+		// First keyframe that comes after the requested frame
+		auto next = std::upper_bound(keyframes.begin(), keyframes.end(), frame, [](float value, const SphereKeyframe& keyframe) { return value < keyframe.Frame; });
+
+		SphereDelta delta;
+		delta.SphereIndex = track.SphereIndex;
+
+		if (next == keyframes.begin())
+		{
+			delta.Position = next->Position;
+			delta.Radius = next->Radius;
+		} else if (next == keyframes.end())
+		{
+			delta.Position = keyframes.back().Position;
+			delta.Radius = keyframes.back().Radius;
+		} else
+		{
+			const SphereKeyframe& previous = *(next - 1);
+			float t = (frame - previous.Frame) / (next->Frame - previous.Frame);
+
+			delta.Position = previous.Position + (next->Position - previous.Position) * t;
+			delta.Radius = previous.Radius + (next->Radius - previous.Radius) * t;
+		}
+
+		// Only spheres that actually moved end up in the delta list
+		const Sphere& sphere = (*scene.m_Spheres)[track.SphereIndex];
+		if (sphere.Position != delta.Position || sphere.Radius != delta.Radius)
+			deltas.push_back(delta);
+	}
+}
+
+void Animation::ApplyDeltas(Scene& scene, const std::vector<SphereDelta>& deltas)
+{
+	// Frames where nothing moved keep sharing the spheres of the frame before
+	if (deltas.empty())
+		return;
+
+	std::vector<Sphere>& spheres = scene.EditSpheres();
+	for (const auto& delta : deltas)
+	{
+		Sphere& sphere = spheres[delta.SphereIndex];
+		sphere.Position = delta.Position;
+		sphere.Radius = delta.Radius;
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "RT/Scene.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+struct SphereKeyframe
+{
+	float Frame = 0.0f;
+	glm::vec3 Position = glm::vec3(0.0f);
+	float Radius = 1.0f;
+};
+
+struct SphereDelta
+{
+	uint32_t SphereIndex = 0;
+	glm::vec3 Position = glm::vec3(0.0f);
+	float Radius = 1.0f;
+};
+
+class Animation
+{
+public:
+	Animation() = default;
+
+	// Keyframes are interpolated linearly, per-frame data is simply a keyframe on every frame
+	void AddKeyframe(uint32_t sphereIndex, const SphereKeyframe& keyframe);
+	void Clear();
+
+	// Collects the spheres whose transform at the given frame differs from the scene
+	void Evaluate(float frame, const Scene& scene, std::vector<SphereDelta>& deltas) const;
+	static void ApplyDeltas(Scene& scene, const std::vector<SphereDelta>& deltas);
+
+	bool IsEmpty() const { return m_Tracks.empty(); }
+
+	float GetFirstFrame() const { return m_FirstFrame; }
+	float GetLastFrame() const { return m_LastFrame; }
+
+private:
+	struct Track
+	{
+		uint32_t SphereIndex = 0;
+		std::vector<SphereKeyframe> Keyframes;
+	};
+
+	std::vector<Track> m_Tracks;
+
+	float m_FirstFrame = 0.0f;
+	float m_LastFrame = 0.0f;
+};
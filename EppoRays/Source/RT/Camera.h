@@ -24,6 +24,9 @@ public:
 	const glm::vec3& GetPosition() const { return m_Position; }
 	const glm::vec3& GetDirection() const { return m_ForwardDirection; }
 
+	uint32_t GetViewportWidth() const { return m_ViewportWidth; }
+	uint32_t GetViewportHeight() const { return m_ViewportHeight; }
+
 	const glm::vec3& GetRayDirection(uint32_t x, uint32_t y) const { return m_RayDirections[y * m_ViewportWidth + x]; }
 
 	float GetRotationSpeed() const;
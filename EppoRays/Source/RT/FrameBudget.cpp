@@ -0,0 +1,37 @@
+#include "FrameBudget.h"
+
+#include <algorithm>
+
+namespace Utils
+{
+	// Smoothing of the measured cost, higher reacts faster but jitters more
+	constexpr float CostSmoothing = 0.25f;
+
+	// Never change the amount of work by more than this factor in one frame
+	constexpr float MaxGrowth = 2.0f;
+
+	constexpr uint64_t MinPixelSamples = 32 * 32;
+}
+
+void FrameBudget::Update(uint64_t frameMicroseconds, uint64_t pixelSamples)
+{
+	if (pixelSamples == 0 || frameMicroseconds == 0)
+		return;
+
+	float cost = (float)frameMicroseconds / (float)pixelSamples;
+	if (m_CostPerSample == 0.0f)
+		m_CostPerSample = cost;
+	else
+		m_CostPerSample += (cost - m_CostPerSample) * Utils::CostSmoothing;
+
+	float next = m_TargetMicroseconds / m_CostPerSample;
+	next = std::clamp(next, (float)pixelSamples / Utils::MaxGrowth, (float)pixelSamples * Utils::MaxGrowth);
+
+	m_PixelSamples = std::max((uint64_t)next, Utils::MinPixelSamples);
+}
+
+void FrameBudget::Reset()
+{
+	m_CostPerSample = 0.0f;
+	m_PixelSamples = 64 * 64;
+}
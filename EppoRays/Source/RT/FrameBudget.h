@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+// Feedback controller that sizes the work of the next pass so rendering it takes the target time.
+// Work is measured in pixel samples, the cost per sample is learned from the measured render times.
+class FrameBudget
+{
+public:
+	FrameBudget() = default;
+
+	void SetTargetFrameTime(float milliseconds) { m_TargetMicroseconds = milliseconds * 1000.0f; }
+	float GetTargetFrameTime() const { return m_TargetMicroseconds / 1000.0f; }
+
+	// The time of the whole Render call, including resolve and upload. UI and presenting are not
+	// included, a whole frame including vsync waits would make the cost per sample meaningless.
+	void Update(uint64_t frameMicroseconds, uint64_t pixelSamples);
+	void Reset();
+
+	uint64_t GetPixelSamples() const { return m_PixelSamples; }
+
+private:
+	float m_TargetMicroseconds = 16666.0f;
+	float m_CostPerSample = 0.0f;
+
+	uint64_t m_PixelSamples = 64 * 64;
+};
@@ -0,0 +1,495 @@
+#include "ImageWriter.h"
+
+#include <EppoCore.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#ifdef EPPO_WINDOWS
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif
+
+// Private to this translation unit so we never clash with an implementation inside EppoCore
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+namespace Utils
+{
+	// Rows are encoded in chunks so large images keep the whole pool busy
+	constexpr uint32_t RowsPerChunk = 32;
+
+	inline static uint32_t GetChunkCount(uint32_t height)
+	{
+		return (height + RowsPerChunk - 1) / RowsPerChunk;
+	}
+
+	inline static glm::vec3 Resolve(const glm::vec3& color, uint32_t samples)
+	{
+		return color / (float)std::max(samples, 1u);
+	}
+
+	// The target accumulates linear radiance, only the integer formats are gamma encoded
+	inline static glm::vec3 GammaEncode(const glm::vec3& color)
+	{
+		return glm::pow(glm::clamp(color, 0.0f, 1.0f), glm::vec3(1.0f / 2.2f));
+	}
+
+	inline static uint16_t ToUInt16(float value)
+	{
+		return (uint16_t)(glm::clamp(value, 0.0f, 1.0f) * 65535.0f);
+	}
+
+	inline static void WriteBigEndian(uint8_t* destination, uint32_t value)
+	{
+		destination[0] = (uint8_t)(value >> 24);
+		destination[1] = (uint8_t)(value >> 16);
+		destination[2] = (uint8_t)(value >> 8);
+		destination[3] = (uint8_t)(value);
+	}
+
+	static uint32_t CRC32(const uint8_t* data, size_t size, uint32_t crc = 0)
+	{
+		static uint32_t table[256] = {};
+		static bool initialized = [&]()
+		{
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint32_t c = i;
+				for (uint32_t k = 0; k < 8; k++)
+					c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+
+				table[i] = c;
+			}
+
+			return true;
+		}();
+		(void)initialized;
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++)
+			crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+		return ~crc;
+	}
+
+	static void WritePNGChunk(std::ofstream& stream, const char* type, const uint8_t* data, uint32_t size)
+	{
+		uint8_t header[8];
+		WriteBigEndian(header, size);
+		memcpy(header + 4, type, 4);
+
+		uint32_t crc = CRC32(header + 4, 4);
+		crc = CRC32(data, size, crc);
+
+		uint8_t footer[4];
+		WriteBigEndian(footer, crc);
+
+		stream.write((const char*)header, sizeof(header));
+		stream.write((const char*)data, size);
+		stream.write((const char*)footer, sizeof(footer));
+	}
+
+	template<typename T>
+	inline static void Append(std::vector<uint8_t>& buffer, const T& value)
+	{
+		const uint8_t* bytes = (const uint8_t*)&value;
+		buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+	}
+
+	inline static void AppendString(std::vector<uint8_t>& buffer, const char* value)
+	{
+		buffer.insert(buffer.end(), value, value + strlen(value) + 1);
+	}
+
+	inline static void AppendAttribute(std::vector<uint8_t>& buffer, const char* name, const char* type, uint32_t size)
+	{
+		AppendString(buffer, name);
+		AppendString(buffer, type);
+		Append(buffer, size);
+	}
+}
+
+ImageWriter::ImageWriter(uint32_t threadCount)
+	: m_Pool(threadCount)
+{}
+
+ImageWriter::~ImageWriter()
+{
+	WaitForAll();
+}
+
+std::shared_future<bool> ImageWriter::Write(const RenderTarget& target, const std::string& filepath, ImageFormat format)
+{
+	// Every pending write holds a full copy of the image, callers that outpace the encoders have to wait
+	{
+		std::unique_lock<std::mutex> lock(m_WritesMutex);
+		m_WriteFinished.wait(lock, [this]() { return m_PendingWrites.load() < m_Pool.GetThreadCount(); });
+		m_PendingWrites++;
+	}
+
+	// Snapshot the accumulation buffer, this is just a copy so the render loop can continue right away
+	auto snapshot = std::make_shared<Snapshot>();
+	snapshot->Width = target.Width;
+	snapshot->Height = target.Height;
+	snapshot->AccumulatedColor = target.AccumulatedColor;
+	snapshot->SampleCount = target.SampleCount;
+
+	auto promise = std::make_shared<std::promise<bool>>();
+	std::shared_future<bool> future = promise->get_future().share();
+
+	m_Pool.Submit([this, snapshot, filepath, format, promise]()
+	{
+		bool result = Encode(*snapshot, filepath, format);
+		if (!result)
+			EPPO_ERROR("Failed to write image '{}'", filepath);
+
+		{
+			std::lock_guard<std::mutex> lock(m_WritesMutex);
+			m_PendingWrites--;
+		}
+
+		m_WriteFinished.notify_all();
+		promise->set_value(result);
+	});
+
+	std::lock_guard<std::mutex> lock(m_WritesMutex);
+
+	// Forget about writes that already finished
+	m_Writes.erase(std::remove_if(m_Writes.begin(), m_Writes.end(), [](const std::shared_future<bool>& write)
+	{
+		return write.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}), m_Writes.end());
+
+	m_Writes.push_back(future);
+
+	return future;
+}
+
+void ImageWriter::WaitForAll()
+{
+	std::vector<std::shared_future<bool>> writes;
+
+	{
+		std::lock_guard<std::mutex> lock(m_WritesMutex);
+		writes.swap(m_Writes);
+	}
+
+	for (auto& write : writes)
+		write.wait();
+}
+
+const char* ImageWriter::GetExtension(ImageFormat format)
+{
+	switch (format)
+	{
+		case ImageFormat::PNG:		return ".png";
+		case ImageFormat::PNG16:	return ".png";
+		case ImageFormat::EXR:		return ".exr";
+		case ImageFormat::Raw:		return ".eraw";
+	}
+
+	return "";
+}
+
+bool ImageWriter::Encode(const Snapshot& snapshot, const std::string& filepath, ImageFormat format)
+{
+	if (snapshot.Width == 0 || snapshot.Height == 0 || snapshot.AccumulatedColor.empty())
+		return false;
+
+	std::filesystem::path path(filepath);
+	if (path.has_parent_path())
+	{
+		std::error_code error;
+		std::filesystem::create_directories(path.parent_path(), error);
+	}
+
+	switch (format)
+	{
+		case ImageFormat::PNG:		return WritePNG(snapshot, filepath);
+		case ImageFormat::PNG16:	return WritePNG16(snapshot, filepath);
+		case ImageFormat::EXR:		return WriteEXR(snapshot, filepath);
+		case ImageFormat::Raw:		return WriteRaw(snapshot, filepath);
+	}
+
+	return false;
+}
+
+bool ImageWriter::WritePNG(const Snapshot& snapshot, const std::string& filepath)
+{
+	uint32_t width = snapshot.Width;
+	uint32_t height = snapshot.Height;
+
+	std::vector<uint8_t> pixels(width * height * 3);
+
+	// Images are stored bottom up, files are written top down
+	m_Pool.ParallelFor(Utils::GetChunkCount(height), [&](uint32_t chunk)
+	{
+		uint32_t lastRow = std::min(height, (chunk + 1) * Utils::RowsPerChunk);
+		for (uint32_t y = chunk * Utils::RowsPerChunk; y < lastRow; y++)
+		{
+			const glm::vec3* source = &snapshot.AccumulatedColor[(height - 1 - y) * width];
+			const uint32_t* samples = &snapshot.SampleCount[(height - 1 - y) * width];
+			uint8_t* destination = &pixels[y * width * 3];
+
+			for (uint32_t x = 0; x < width; x++)
+			{
+				glm::vec3 color = Utils::GammaEncode(Utils::Resolve(source[x], samples[x]));
+				destination[x * 3 + 0] = (uint8_t)(color.r * 255.0f);
+				destination[x * 3 + 1] = (uint8_t)(color.g * 255.0f);
+				destination[x * 3 + 2] = (uint8_t)(color.b * 255.0f);
+			}
+		}
+	});
+
+	// Deflate itself is sequential, but each write runs on its own worker
+	return stbi_write_png(filepath.c_str(), (int)width, (int)height, 3, pixels.data(), (int)width * 3) != 0;
+}
+
+bool ImageWriter::WritePNG16(const Snapshot& snapshot, const std::string& filepath)
+{
+	uint32_t width = snapshot.Width;
+	uint32_t height = snapshot.Height;
+
+	// Every row starts with its filter type, we use the 'sub' filter with a 6 byte pixel stride
+	uint32_t rowSize = 1 + width * 6;
+	std::vector<uint8_t> rows(rowSize * height);
+
+	m_Pool.ParallelFor(Utils::GetChunkCount(height), [&](uint32_t chunk)
+	{
+		uint32_t lastRow = std::min(height, (chunk + 1) * Utils::RowsPerChunk);
+		for (uint32_t y = chunk * Utils::RowsPerChunk; y < lastRow; y++)
+		{
+			const glm::vec3* source = &snapshot.AccumulatedColor[(height - 1 - y) * width];
+			const uint32_t* samples = &snapshot.SampleCount[(height - 1 - y) * width];
+			uint8_t* destination = &rows[y * rowSize];
+			destination[0] = 1;
+
+			uint8_t* bytes = destination + 1;
+			for (uint32_t x = 0; x < width; x++)
+			{
+				glm::vec3 color = Utils::GammaEncode(Utils::Resolve(source[x], samples[x]));
+
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					uint16_t value = Utils::ToUInt16(color[c]);
+					bytes[x * 6 + c * 2 + 0] = (uint8_t)(value >> 8);
+					bytes[x * 6 + c * 2 + 1] = (uint8_t)(value & 0xff);
+				}
+			}
+
+			// Filters work on bytes, not samples. Going backwards keeps the unfiltered bytes we subtract.
+			for (uint32_t i = width * 6 - 1; i >= 6; i--)
+				bytes[i] = (uint8_t)(bytes[i] - bytes[i - 6]);
+		}
+	});
+
+	int compressedSize = 0;
+	uint8_t* compressed = stbi_zlib_compress(rows.data(), (int)rows.size(), &compressedSize, 8);
+	if (!compressed)
+		return false;
+
+	std::ofstream stream(filepath, std::ios::binary);
+	if (!stream)
+	{
+		STBIW_FREE(compressed);
+		return false;
+	}
+
+	const uint8_t signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	stream.write((const char*)signature, sizeof(signature));
+
+	// Bit depth 16, color type 2 (RGB), default compression, filter and interlace methods
+	uint8_t header[13] = {};
+	Utils::WriteBigEndian(header, width);
+	Utils::WriteBigEndian(header + 4, height);
+	header[8] = 16;
+	header[9] = 2;
+
+	Utils::WritePNGChunk(stream, "IHDR", header, sizeof(header));
+	Utils::WritePNGChunk(stream, "IDAT", compressed, (uint32_t)compressedSize);
+	Utils::WritePNGChunk(stream, "IEND", nullptr, 0);
+
+	STBIW_FREE(compressed);
+
+	return stream.good();
+}
+
+bool ImageWriter::WriteEXR(const Snapshot& snapshot, const std::string& filepath)
+{
+	uint32_t width = snapshot.Width;
+	uint32_t height = snapshot.Height;
+
+	std::vector<uint8_t> header;
+	Utils::Append(header, 20000630u);	// Magic number
+	Utils::Append(header, 2u);			// Version 2, single part scanline file
+
+	// Channels are stored in alphabetical order
+	Utils::AppendAttribute(header, "channels", "chlist", 3 * (2 + 16) + 1);
+	for (const char* channel : { "B", "G", "R" })
+	{
+		Utils::AppendString(header, channel);
+		Utils::Append(header, 2u);		// FLOAT
+		Utils::Append(header, 0u);		// pLinear and reserved
+		Utils::Append(header, 1u);		// xSampling
+		Utils::Append(header, 1u);		// ySampling
+	}
+	header.push_back(0);
+
+	Utils::AppendAttribute(header, "compression", "compression", 1);
+	header.push_back(0);				// NO_COMPRESSION
+
+	for (const char* window : { "dataWindow", "displayWindow" })
+	{
+		Utils::AppendAttribute(header, window, "box2i", 16);
+		Utils::Append(header, 0);
+		Utils::Append(header, 0);
+		Utils::Append(header, (int32_t)width - 1);
+		Utils::Append(header, (int32_t)height - 1);
+	}
+
+	Utils::AppendAttribute(header, "lineOrder", "lineOrder", 1);
+	header.push_back(0);				// INCREASING_Y
+
+	Utils::AppendAttribute(header, "pixelAspectRatio", "float", 4);
+	Utils::Append(header, 1.0f);
+
+	Utils::AppendAttribute(header, "screenWindowCenter", "v2f", 8);
+	Utils::Append(header, 0.0f);
+	Utils::Append(header, 0.0f);
+
+	Utils::AppendAttribute(header, "screenWindowWidth", "float", 4);
+	Utils::Append(header, 1.0f);
+
+	header.push_back(0);
+
+	// Without compression every scanline has the same size, so each chunk knows where to write
+	uint32_t lineDataSize = width * 3 * sizeof(float);
+	uint64_t lineSize = sizeof(int32_t) * 2 + lineDataSize;
+	uint64_t offsetTableSize = (uint64_t)height * sizeof(uint64_t);
+	uint64_t dataOffset = header.size() + offsetTableSize;
+
+	std::vector<uint8_t> file(dataOffset + lineSize * height);
+	memcpy(file.data(), header.data(), header.size());
+
+	m_Pool.ParallelFor(Utils::GetChunkCount(height), [&](uint32_t chunk)
+	{
+		uint32_t lastRow = std::min(height, (chunk + 1) * Utils::RowsPerChunk);
+		for (uint32_t y = chunk * Utils::RowsPerChunk; y < lastRow; y++)
+		{
+			uint64_t lineOffset = dataOffset + lineSize * y;
+			memcpy(&file[header.size() + y * sizeof(uint64_t)], &lineOffset, sizeof(uint64_t));
+
+			uint8_t* line = &file[lineOffset];
+			int32_t lineY = (int32_t)y;
+			memcpy(line, &lineY, sizeof(int32_t));
+			memcpy(line + sizeof(int32_t), &lineDataSize, sizeof(int32_t));
+
+			float* channels = (float*)(line + sizeof(int32_t) * 2);
+			const glm::vec3* source = &snapshot.AccumulatedColor[(height - 1 - y) * width];
+			const uint32_t* samples = &snapshot.SampleCount[(height - 1 - y) * width];
+
+			for (uint32_t x = 0; x < width; x++)
+			{
+				glm::vec3 color = Utils::Resolve(source[x], samples[x]);
+				channels[x] = color.b;
+				channels[width + x] = color.g;
+				channels[width * 2 + x] = color.r;
+			}
+		}
+	});
+
+	std::ofstream stream(filepath, std::ios::binary);
+	if (!stream)
+		return false;
+
+	stream.write((const char*)file.data(), file.size());
+
+	return stream.good();
+}
+
+bool ImageWriter::WriteRaw(const Snapshot& snapshot, const std::string& filepath)
+{
+	uint32_t width = snapshot.Width;
+	uint32_t height = snapshot.Height;
+
+	RawImageHeader rawHeader;
+	rawHeader.Width = width;
+	rawHeader.Height = height;
+	rawHeader.SampleCount = *std::max_element(snapshot.SampleCount.begin(), snapshot.SampleCount.end());
+
+	size_t size = sizeof(RawImageHeader) + (size_t)width * height * sizeof(glm::vec3);
+
+	#ifdef EPPO_WINDOWS
+		HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)(size & 0xffffffff), nullptr);
+		if (!mapping)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		uint8_t* mapped = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+		if (!mapped)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+	#else
+		int file = open(filepath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (file < 0)
+			return false;
+
+		if (ftruncate(file, (off_t)size) != 0)
+		{
+			close(file);
+			return false;
+		}
+
+		uint8_t* mapped = (uint8_t*)mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+		if (mapped == MAP_FAILED)
+		{
+			close(file);
+			return false;
+		}
+	#endif
+
+	memcpy(mapped, &rawHeader, sizeof(RawImageHeader));
+	glm::vec3* pixels = (glm::vec3*)(mapped + sizeof(RawImageHeader));
+
+	m_Pool.ParallelFor(Utils::GetChunkCount(height), [&](uint32_t chunk)
+	{
+		uint32_t lastRow = std::min(height, (chunk + 1) * Utils::RowsPerChunk);
+		for (uint32_t y = chunk * Utils::RowsPerChunk; y < lastRow; y++)
+		{
+			const glm::vec3* source = &snapshot.AccumulatedColor[(height - 1 - y) * width];
+			const uint32_t* samples = &snapshot.SampleCount[(height - 1 - y) * width];
+			glm::vec3* destination = &pixels[y * width];
+
+			for (uint32_t x = 0; x < width; x++)
+				destination[x] = Utils::Resolve(source[x], samples[x]);
+		}
+	});
+
+	#ifdef EPPO_WINDOWS
+		UnmapViewOfFile(mapped);
+		CloseHandle(mapping);
+		CloseHandle(file);
+	#else
+		munmap(mapped, size);
+		close(file);
+	#endif
+
+	return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "RT/RenderTarget.h"
+#include "RT/ThreadPool.h"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class ImageFormat
+{
+	PNG,	// 8-bit RGB, gamma encoded
+	PNG16,	// 16-bit RGB, gamma encoded
+	EXR,	// 32-bit float linear RGB, uncompressed scanlines
+	Raw		// RawImageHeader followed by 32-bit float linear RGB, written through a memory mapped file
+};
+
+struct RawImageHeader
+{
+	char Magic[4] = { 'E', 'R', 'A', 'W' };
+	uint32_t Version = 1;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	uint32_t Channels = 3;
+	uint32_t SampleCount = 0;	// Samples of the most converged pixel
+};
+
+class ImageWriter
+{
+public:
+	// A thread count of 0 uses all hardware threads
+	explicit ImageWriter(uint32_t threadCount = 0);
+	~ImageWriter();
+
+	// Snapshots the accumulated image on the calling thread, encoding and file IO happen on the pool.
+	// Blocks while there are as many writes pending as the pool has threads.
+	std::shared_future<bool> Write(const RenderTarget& target, const std::string& filepath, ImageFormat format);
+	void WaitForAll();
+
+	uint32_t GetPendingWrites() const { return m_PendingWrites.load(); }
+
+	static const char* GetExtension(ImageFormat format);
+
+private:
+	struct Snapshot
+	{
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		std::vector<glm::vec3> AccumulatedColor;
+		std::vector<uint32_t> SampleCount;
+	};
+
+	bool Encode(const Snapshot& snapshot, const std::string& filepath, ImageFormat format);
+
+	bool WritePNG(const Snapshot& snapshot, const std::string& filepath);
+	bool WritePNG16(const Snapshot& snapshot, const std::string& filepath);
+	bool WriteEXR(const Snapshot& snapshot, const std::string& filepath);
+	bool WriteRaw(const Snapshot& snapshot, const std::string& filepath);
+
+private:
+	ThreadPool m_Pool;
+
+	std::atomic<uint32_t> m_PendingWrites = 0;
+	std::vector<std::shared_future<bool>> m_Writes;
+	std::mutex m_WritesMutex;
+	std::condition_variable m_WriteFinished;
+};
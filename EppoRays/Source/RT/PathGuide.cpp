@@ -0,0 +1,196 @@
+#include "PathGuide.h"
+
+#include <algorithm>
+
+namespace Utils
+{
+	// Radiance is accumulated in fixed point so workers can train with plain atomic adds
+	constexpr float FixedPointScale = 1024.0f;
+	constexpr float MaxRadiance = 1024.0f;
+
+	// Cells need this many samples before their distribution is used for sampling
+	constexpr uint32_t MinTrainingSamples = 64;
+
+	// Cells that gathered this many samples since the last refinement get split
+	constexpr uint32_t SplitThreshold = 4096;
+	constexpr uint32_t MaxDepth = 24;
+	constexpr uint32_t MaxCells = 4096;
+
+	// Part of every distribution stays uniform so directions the cache missed can still be found
+	constexpr float UniformFraction = 0.1f;
+
+	constexpr float Pi = 3.14159265358979f;
+	constexpr float BinSolidAngle = 4.0f * Pi / (float)PathGuide::BinCount;
+}
+
+void PathGuide::Reset(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	m_Nodes.clear();
+	m_Cells.clear();
+
+	Node& root = m_Nodes.emplace_back();
+	root.BoundsMin = boundsMin;
+	root.BoundsMax = boundsMax;
+	root.Index = 0;
+
+	m_Cells.emplace_back();
+}
+
+void PathGuide::Refine()
+{
+	// Leaves created by a split are already up to date, only visit the nodes that existed before
+	uint32_t nodeCount = (uint32_t)m_Nodes.size();
+	for (uint32_t i = 0; i < nodeCount; i++)
+	{
+		if (!m_Nodes[i].Leaf)
+			continue;
+
+		Cell& cell = m_Cells[m_Nodes[i].Index];
+		uint32_t sampleCount = cell.SampleCount.load(std::memory_order_relaxed);
+
+		BuildDistribution(cell);
+
+		if (sampleCount >= Utils::SplitThreshold && m_Nodes[i].Depth < Utils::MaxDepth && m_Cells.size() + 1 < Utils::MaxCells)
+			SplitNode(i);
+	}
+}
+
+uint32_t PathGuide::Lookup(const glm::vec3& position) const
+{
+	uint32_t nodeIndex = 0;
+	while (!m_Nodes[nodeIndex].Leaf)
+	{
+		const Node& node = m_Nodes[nodeIndex];
+		nodeIndex = node.Index + (position[node.Axis] < node.Split ? 0 : 1);
+	}
+
+	return m_Nodes[nodeIndex].Index;
+}
+
+glm::vec3 PathGuide::Sample(uint32_t cell, float u0, float u1, float u2) const
+{
+	const auto& cdf = m_Cells[cell].Cdf;
+	uint32_t bin = (uint32_t)(std::upper_bound(cdf.begin(), cdf.end(), u0) - cdf.begin());
+	bin = std::min(bin, BinCount - 1);
+
+	// Uniform within the bin, the grid is equal-area in (cos theta, phi)
+	uint32_t theta = bin / PhiBins;
+	uint32_t phi = bin % PhiBins;
+
+	float cosTheta = ((float)theta + u1) / (float)ThetaBins * 2.0f - 1.0f;
+	float sinTheta = glm::sqrt(glm::max(0.0f, 1.0f - cosTheta * cosTheta));
+	float angle = ((float)phi + u2) / (float)PhiBins * 2.0f * Utils::Pi - Utils::Pi;
+
+	return glm::vec3(sinTheta * glm::cos(angle), cosTheta, sinTheta * glm::sin(angle));
+}
+
+float PathGuide::Pdf(uint32_t cell, const glm::vec3& direction) const
+{
+	return m_Cells[cell].Probability[GetBin(direction)] / Utils::BinSolidAngle;
+}
+
+void PathGuide::Record(uint32_t cell, const glm::vec3& direction, float radiance) const
+{
+	const Cell& target = m_Cells[cell];
+	target.SampleCount.fetch_add(1, std::memory_order_relaxed);
+
+	if (radiance <= 0.0f)
+		return;
+
+	uint64_t value = (uint64_t)(std::min(radiance, Utils::MaxRadiance) * Utils::FixedPointScale);
+	target.Radiance[GetBin(direction)].fetch_add(value, std::memory_order_relaxed);
+}
+
+uint32_t PathGuide::GetBin(const glm::vec3& direction)
+{
+	float u = (direction.y + 1.0f) * 0.5f;
+	float v = (glm::atan(direction.z, direction.x) + Utils::Pi) / (2.0f * Utils::Pi);
+
+	uint32_t theta = std::min((uint32_t)(glm::max(u, 0.0f) * ThetaBins), ThetaBins - 1);
+	uint32_t phi = std::min((uint32_t)(glm::max(v, 0.0f) * PhiBins), PhiBins - 1);
+
+	return theta * PhiBins + phi;
+}
+
+void PathGuide::BuildDistribution(Cell& cell)
+{
+	uint64_t total = 0;
+	for (const auto& radiance : cell.Radiance)
+		total += radiance.load(std::memory_order_relaxed);
+
+	uint32_t sampleCount = cell.SampleCount.load(std::memory_order_relaxed);
+	if (total > 0 && sampleCount >= Utils::MinTrainingSamples)
+	{
+		float sum = 0.0f;
+		for (uint32_t i = 0; i < BinCount; i++)
+		{
+			float learned = (float)cell.Radiance[i].load(std::memory_order_relaxed) / (float)total;
+			cell.Probability[i] = learned * (1.0f - Utils::UniformFraction) + Utils::UniformFraction / (float)BinCount;
+
+			sum += cell.Probability[i];
+			cell.Cdf[i] = sum;
+		}
+
+		cell.Cdf[BinCount - 1] = 1.0f;
+		cell.Trained = true;
+	}
+
+	// Old estimates fade out so the cache keeps adapting, the halved counts still seed the next round
+	for (auto& radiance : cell.Radiance)
+		radiance.store(radiance.load(std::memory_order_relaxed) / 2, std::memory_order_relaxed);
+	cell.SampleCount.store(sampleCount / 2, std::memory_order_relaxed);
+}
+
+void PathGuide::SplitNode(uint32_t nodeIndex)
+{
+	uint32_t firstChild = (uint32_t)m_Nodes.size();
+	uint32_t parentCell = m_Nodes[nodeIndex].Index;
+
+	// Split the longest axis in the middle. Children are built as copies, pushing them can reallocate the nodes.
+	glm::vec3 extent = m_Nodes[nodeIndex].BoundsMax - m_Nodes[nodeIndex].BoundsMin;
+	uint32_t axis = 0;
+	if (extent.y > extent[axis])
+		axis = 1;
+	if (extent.z > extent[axis])
+		axis = 2;
+
+	float split = m_Nodes[nodeIndex].BoundsMin[axis] + extent[axis] * 0.5f;
+
+	Node left = m_Nodes[nodeIndex];
+	left.Depth++;
+	left.BoundsMax[axis] = split;
+
+	Node right = left;
+	right.BoundsMin[axis] = split;
+	right.BoundsMax[axis] = m_Nodes[nodeIndex].BoundsMax[axis];
+
+	// The left child keeps the parent cell, the right one starts as a copy of it
+	left.Index = parentCell;
+	right.Index = (uint32_t)m_Cells.size();
+
+	Cell& source = m_Cells[parentCell];
+	Cell& copy = m_Cells.emplace_back();
+	for (uint32_t i = 0; i < BinCount; i++)
+	{
+		uint64_t half = source.Radiance[i].load(std::memory_order_relaxed) / 2;
+		source.Radiance[i].store(half, std::memory_order_relaxed);
+		copy.Radiance[i].store(half, std::memory_order_relaxed);
+	}
+
+	uint32_t halfCount = source.SampleCount.load(std::memory_order_relaxed) / 2;
+	source.SampleCount.store(halfCount, std::memory_order_relaxed);
+	copy.SampleCount.store(halfCount, std::memory_order_relaxed);
+
+	copy.Cdf = source.Cdf;
+	copy.Probability = source.Probability;
+	copy.Trained = source.Trained;
+
+	m_Nodes.push_back(left);
+	m_Nodes.push_back(right);
+
+	Node& parent = m_Nodes[nodeIndex];
+	parent.Leaf = false;
+	parent.Axis = axis;
+	parent.Split = split;
+	parent.Index = firstChild;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+// Online path guiding cache. Space is subdivided by a kd-tree over the scene bounds and every leaf
+// holds a distribution over directions on an equal-area grid. Worker threads train the current
+// cells with lock free atomics while tracing, Refine turns that into sampling distributions and
+// splits busy cells. Refine must not run concurrently with tracing.
+class PathGuide
+{
+public:
+	static constexpr uint32_t ThetaBins = 8;
+	static constexpr uint32_t PhiBins = 16;
+	static constexpr uint32_t BinCount = ThetaBins * PhiBins;
+
+public:
+	PathGuide() = default;
+
+	void Reset(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	void Refine();
+
+	bool IsEmpty() const { return m_Nodes.empty(); }
+	uint32_t GetCellCount() const { return (uint32_t)m_Cells.size(); }
+
+	uint32_t Lookup(const glm::vec3& position) const;
+	bool IsTrained(uint32_t cell) const { return m_Cells[cell].Trained; }
+
+	glm::vec3 Sample(uint32_t cell, float u0, float u1, float u2) const;
+	float Pdf(uint32_t cell, const glm::vec3& direction) const;
+
+	// Thread safe, radiance arriving at a point in the cell from the given direction
+	void Record(uint32_t cell, const glm::vec3& direction, float radiance) const;
+
+private:
+	struct Node
+	{
+		glm::vec3 BoundsMin = glm::vec3(0.0f);
+		glm::vec3 BoundsMax = glm::vec3(0.0f);
+
+		uint32_t Axis = 0;
+		float Split = 0.0f;
+
+		// First of two children for interior nodes, the cell for leaves
+		uint32_t Index = 0;
+		uint32_t Depth = 0;
+		bool Leaf = true;
+	};
+
+	struct Cell
+	{
+		// Training data, written concurrently while tracing
+		mutable std::array<std::atomic<uint64_t>, BinCount> Radiance = {};
+		mutable std::atomic<uint32_t> SampleCount = 0;
+
+		// Sampling data, only written by Refine
+		std::array<float, BinCount> Cdf = {};
+		std::array<float, BinCount> Probability = {};
+		bool Trained = false;
+	};
+
+	static uint32_t GetBin(const glm::vec3& direction);
+	void BuildDistribution(Cell& cell);
+	void SplitNode(uint32_t nodeIndex);
+
+private:
+	std::vector<Node> m_Nodes;
+
+	// Cells hold atomics and can't be moved, a deque never relocates them when growing
+	std::deque<Cell> m_Cells;
+};
@@ -7,3 +7,10 @@ struct Ray
 	glm::vec3 Origin = glm::vec3(0.0f, 0.0f, 0.0f);
 	glm::vec3 Direction = glm::vec3(0.0f, 0.0f, 0.0f);
 };
+
+// Footprint of a ray, grows with distance and with every rough bounce
+struct RayCone
+{
+	float Width = 0.0f;
+	float Spread = 0.0f;
+};
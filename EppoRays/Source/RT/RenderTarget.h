@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+struct RenderTarget
+{
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	uint32_t FrameIndex = 1;
+
+	// Pixels from an older epoch are cleared the next time they get rendered, so a reset
+	// doesn't have to touch pixels that a partial pass never reaches
+	uint32_t Epoch = 1;
+
+	std::vector<glm::vec3> AccumulatedColor;
+	std::vector<uint32_t> SampleCount;
+	std::vector<uint32_t> PixelEpoch;
+	std::vector<uint32_t> ImageData;
+
+	void Resize(uint32_t width, uint32_t height)
+	{
+		Width = width;
+		Height = height;
+		FrameIndex = 1;
+		Epoch = 1;
+
+		AccumulatedColor.assign(width * height, glm::vec3(0.0f));
+		SampleCount.assign(width * height, 0);
+		PixelEpoch.assign(width * height, 0);
+		ImageData.assign(width * height, 0);
+	}
+
+	void Reset()
+	{
+		FrameIndex = 1;
+		Epoch++;
+	}
+};
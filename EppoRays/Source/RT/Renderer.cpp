@@ -2,11 +2,6 @@
 
 #include <EppoCore/Core/Random.h>
 
-// TODO: Find solution that is platform agnostic
-#ifdef EPPO_WINDOWS
-	#include <execution>
-#endif
-
 namespace Utils
 {
 	inline static uint32_t ConvertToRGBA(const glm::vec4& color)
@@ -19,6 +14,72 @@ namespace Utils
 		return (a << 24) | (b << 16) | (g << 8) | r;
 	}
 
+	constexpr float Pi = 3.14159265358979f;
+
+	// Same hash as the shader, the seed advances with every number drawn
+	inline static float RandomFloat(uint32_t& seed)
+	{
+		uint32_t state = seed * 747796405u + 2891336453u;
+		uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+		seed = (word >> 22u) ^ word;
+
+		return (float)seed / (float)UINT32_MAX;
+	}
+
+	inline static float Luminance(const glm::vec3& color)
+	{
+		return glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+	}
+
+	// Orthonormal basis around a unit vector, without branches on the direction (Duff et al. 2017)
+	inline static void MakeBasis(const glm::vec3& axis, glm::vec3& tangent, glm::vec3& bitangent)
+	{
+		float sign = std::copysign(1.0f, axis.z);
+		float a = -1.0f / (sign + axis.z);
+		float b = axis.x * axis.y * a;
+
+		tangent = glm::vec3(1.0f + sign * axis.x * axis.x * a, sign * b, -sign * axis.x);
+		bitangent = glm::vec3(b, sign + axis.y * axis.y * a, -axis.y);
+	}
+
+	// Materials reflect into a cos^n lobe around the mirror direction, rougher materials have a wider lobe
+	inline static float GetLobeExponent(float roughness)
+	{
+		return 2.0f / glm::max(roughness * roughness, 1e-4f) - 2.0f;
+	}
+
+	inline static glm::vec3 SampleLobe(const glm::vec3& axis, float exponent, float u1, float u2)
+	{
+		float cosTheta = glm::pow(u1, 1.0f / (exponent + 1.0f));
+		float sinTheta = glm::sqrt(glm::max(1.0f - cosTheta * cosTheta, 0.0f));
+		float phi = 2.0f * Pi * u2;
+
+		glm::vec3 tangent, bitangent;
+		MakeBasis(axis, tangent, bitangent);
+
+		return tangent * (sinTheta * glm::cos(phi)) + bitangent * (sinTheta * glm::sin(phi)) + axis * cosTheta;
+	}
+
+	inline static float GetLobePdf(const glm::vec3& axis, float exponent, const glm::vec3& direction)
+	{
+		float cosTheta = glm::dot(axis, direction);
+		if (cosTheta <= 0.0f)
+			return 0.0f;
+
+		return (exponent + 1.0f) / (2.0f * Pi) * glm::pow(cosTheta, exponent);
+	}
+
+	inline static uint32_t ResolvePixel(const glm::vec3& accumulatedColor, uint32_t sampleCount)
+	{
+		glm::vec3 color = accumulatedColor / (float)sampleCount;
+		color = glm::clamp(color, 0.0f, 1.0f);
+
+		// Gamma correction, the target itself stays linear
+		color = glm::pow(color, glm::vec3(1.0f / 2.2f));
+
+		return ConvertToRGBA(glm::vec4(color, 1.0f));
+	}
+
 	inline static glm::vec3 Lerp(const glm::vec3& startValue, const glm::vec3& endValue, float value)
 	{
 		// blendedValue = (1 - a) * start + a * end
@@ -27,6 +88,49 @@ namespace Utils
 		return (1.0f - a) * startValue + a * endValue;
 	}
 
+	// Returns the distance to the front of the sphere, or a negative value on a miss
+	inline static float IntersectSphere(const Ray& ray, const glm::vec3& position, float radius)
+	{
+		glm::vec3 origin = ray.Origin - position;
+
+		// (bx^2 + by^2)t^2 + (2(axbx + ayby))t + (ax^2 + ay^2 - r^2) = 0
+		// where
+		// a = ray origin
+		// b = ray direction
+		// r = radius
+		// t = hit distance
+		float a = glm::dot(ray.Direction, ray.Direction);
+		float b = 2.0f * glm::dot(origin, ray.Direction);
+		float c = glm::dot(origin, origin) - radius * radius;
+
+		// Quadratic forumula discriminant:
+		// b^2 - 4ac
+		float discriminant = b * b - 4.0f * a * c;
+		if (discriminant < 0)
+			return -1.0f;
+
+		// Quadratic formula:
+		// (-b +- sqrt(discriminant)) / 2a
+
+		//float t1 = (-b + sqrtD) / (2.0f * a);
+		return (-b - glm::sqrt(discriminant)) / (2.0f * a);
+	}
+
+	// Slab test, entry is negative when the ray starts inside the bounds
+	inline static bool IntersectBounds(const Ray& ray, const glm::vec3& inverseDirection, const glm::vec3& boundsMin, const glm::vec3& boundsMax, float maxDistance, float& entry)
+	{
+		glm::vec3 t0 = (boundsMin - ray.Origin) * inverseDirection;
+		glm::vec3 t1 = (boundsMax - ray.Origin) * inverseDirection;
+
+		glm::vec3 tMin = glm::min(t0, t1);
+		glm::vec3 tMax = glm::max(t0, t1);
+
+		entry = std::max(tMin.x, std::max(tMin.y, tMin.z));
+		float exit = std::min(tMax.x, std::min(tMax.y, tMax.z));
+
+		return entry <= exit && exit > 0.0f && entry < maxDistance;
+	}
+
 	inline static void LogMinMaxAvg(const std::vector<glm::vec3>& values, const std::string& name)
 	{
 		glm::vec3 min(0.0f), max(0.0f), avg(0.0f);
@@ -74,80 +178,452 @@ void Renderer::OnResize(uint32_t width, uint32_t height)
 		return;
 
 	m_Image = std::make_shared<Eppo::Image>(width, height);
-	delete[] m_ImageData;
-	m_ImageData = new uint32_t[width * height];
-
-	delete[] m_AccumulatedColorData;
-	m_AccumulatedColorData = new glm::vec3[width * height];
-	m_FrameIndex = 1;
+	m_Target.Resize(width, height);
 
 	m_PixelSB = std::make_shared<Eppo::Buffer>(width * height * sizeof(glm::vec4), 0);
 
-	m_VerticalIterator.resize(height);
-	for (uint32_t i = 0; i < height; i++)
-		m_VerticalIterator[i] = i;
-		
 	m_ViewportWidth = width;
 	m_ViewportHeight = height;
 }
 
-void Renderer::Render(const Scene& scene, const Camera& camera, RenderMode mode)
+void Renderer::Render(const Scene& scene, const Camera& camera, RenderMode mode, bool useRegions)
 {
 	m_Settings.Mode = mode;
 
 	m_ActiveCamera = &camera;
 	m_ActiveScene = &scene;
 
-	if (m_FrameIndex == 1)
-		memset(m_AccumulatedColorData, 0, m_Image->GetWidth() * m_Image->GetHeight() * sizeof(glm::vec3));
+	SelectKernel();
+	if (mode != RenderMode::Gpu)
+	{
+		UpdateHierarchy();
+		UpdatePathGuide();
+	}
+
+	m_Views.clear();
+	m_Views.push_back({ &camera, &m_Target });
+
+	m_Tiles.clear();
+	BuildTiles(0, useRegions);
+	PlanPass();
+
+	// With an interval, the resolve covers the whole image so pixels of partial passes aren't missed
+	bool display = ++m_PassesSinceDisplay >= std::max(m_Settings.DisplayInterval, 1u);
+	bool resolveTiles = display && m_Settings.DisplayInterval <= 1;
 
 	switch (mode)
 	{
-		case RenderMode::CpuST: RenderST(); break;
-		case RenderMode::CpuMT: RenderMT(); break;
-		case RenderMode::Gpu:	RenderGPU(); break;
+		case RenderMode::CpuST: RenderST(resolveTiles); break;
+		case RenderMode::CpuMT: RenderMT(resolveTiles); break;
+		case RenderMode::Gpu:	m_PassSamples = m_PassFocusSamples = 1; RenderGPU(); break;
+	}
+
+	if (display)
+	{
+		if (!resolveTiles && mode != RenderMode::Gpu)
+			ResolveImage(m_Target);
+
+		m_Image->SetData(m_Target.ImageData.data(), m_Image->GetWidth() * m_Image->GetHeight());
+		m_PassesSinceDisplay = 0;
+	}
+
+	AdvanceFrame(m_Target);
+}
+
+void Renderer::RenderViews(const Scene& scene, const std::vector<RenderView>& views)
+{
+	m_ActiveScene = &scene;
+
+	// Everything that only depends on the scene is done once for all views
+	SelectKernel();
+	UpdateHierarchy();
+	UpdatePathGuide();
+
+	m_Views.clear();
+	m_Tiles.clear();
+
+	for (const auto& view : views)
+	{
+		if (!view.ViewCamera || !view.Target || view.Target->Width == 0 || view.Target->Height == 0)
+			continue;
+
+		if (view.ViewCamera->GetViewportWidth() != view.Target->Width || view.ViewCamera->GetViewportHeight() != view.Target->Height)
+		{
+			EPPO_WARN("Skipping view, camera size does not match its render target");
+			continue;
+		}
+
+		m_Views.push_back(view);
+		BuildTiles((uint32_t)m_Views.size() - 1, false);
+	}
+
+	// Targets of multiple views are only ever read through their accumulated color, so there is
+	// nothing to resolve
+	m_PassSamples = std::max(m_Settings.SamplesPerPass, 1u);
+	m_PassFocusSamples = m_PassSamples;
+	RenderMT(false);
+
+	for (const auto& view : m_Views)
+		AdvanceFrame(*view.Target);
+}
+
+void Renderer::Render(const SceneStore& store, const Camera& camera, RenderMode mode)
+{
+	SceneStore::Snapshot snapshot = store.Acquire();
+	if (snapshot.GetVersion() != m_SceneVersion)
+	{
+		m_SceneVersion = snapshot.GetVersion();
+		OnSceneChanged();
+	}
+
+	Render(*snapshot, camera, mode);
+}
+
+void Renderer::RenderViews(const SceneStore& store, const std::vector<RenderView>& views)
+{
+	SceneStore::Snapshot snapshot = store.Acquire();
+	if (snapshot.GetVersion() != m_SceneVersion)
+	{
+		m_SceneVersion = snapshot.GetVersion();
+		OnSceneChanged();
+	}
+
+	RenderViews(*snapshot, views);
+}
+
+void Renderer::OnSceneChanged(bool rebuild)
+{
+	m_HierarchyDirty = true;
+	m_RebuildHierarchy |= rebuild;
+}
+
+void Renderer::UpdateHierarchy()
+{
+	// Refitting is linear in the number of spheres, so switching between scenes with the same
+	// layout (like the double buffered frames of a sequence) stays cheap
+	if (m_RebuildHierarchy || m_Hierarchy.GetSphereCount() != m_ActiveScene->m_Spheres->size())
+	{
+		m_Hierarchy.Build(*m_ActiveScene);
+		m_PathGuideDirty = true;
+	} else if (m_HierarchyDirty || m_HierarchyScene != m_ActiveScene)
+	{
+		m_Hierarchy.Refit(*m_ActiveScene);
+		m_PathGuideDirty = true;
 	}
 
-	m_Image->SetData(m_ImageData, m_Image->GetWidth() * m_Image->GetHeight());
+	m_HierarchyScene = m_ActiveScene;
+	m_HierarchyDirty = false;
+	m_RebuildHierarchy = false;
+}
+
+void Renderer::UpdatePathGuide()
+{
+	if (!m_Settings.UsePathGuiding || m_Hierarchy.GetNodes().empty())
+		return;
 
+	// Learned light is only valid for the scene it was learned in, any edit starts over
+	if (m_PathGuideDirty || m_PathGuide.IsEmpty())
+	{
+		const SphereHierarchy::Node& root = m_Hierarchy.GetNodes()[0];
+		m_PathGuide.Reset(root.BoundsMin, root.BoundsMax);
+
+		m_PathGuideDirty = false;
+		m_PathGuidePasses = 0;
+		return;
+	}
+
+	// Refine after every doubling of the training passes, once converged only every 64 passes
+	m_PathGuidePasses++;
+	if ((m_PathGuidePasses & (m_PathGuidePasses - 1)) == 0 || m_PathGuidePasses % 64 == 0)
+		m_PathGuide.Refine();
+}
+
+void Renderer::AdvanceFrame(RenderTarget& target) const
+{
 	if (m_Settings.Accumulate)
-		m_FrameIndex++;
+		target.FrameIndex += m_PassSamples;
 	else
-		m_FrameIndex = 1;
+		target.Reset();
+}
+
+template<bool HasEmission, bool AllSpecular, size_t... Bounces>
+constexpr std::array<Renderer::RayGenFn, sizeof...(Bounces)> Renderer::MakeKernels(std::index_sequence<Bounces...>)
+{
+	return { &Renderer::RayGen<HasEmission, AllSpecular, (uint32_t)Bounces + 1>... };
+}
+
+void Renderer::SelectKernel()
+{
+	bool hasEmission = false;
+	bool allSpecular = true;
+
+	for (const auto& material : *m_ActiveScene->m_Materials)
+	{
+		if (material.EmissionPower > 0.0f && material.Emission != glm::vec3(0.0f))
+			hasEmission = true;
+
+		if (material.Roughness != 0.0f)
+			allSpecular = false;
+	}
+
+	uint32_t bounces = glm::clamp(m_Settings.Bounces, 1u, MaxBounces);
+
+	using BounceSequence = std::make_index_sequence<MaxBounces>;
+	static constexpr std::array<std::array<std::array<RayGenFn, MaxBounces>, 2>, 2> kernels = {{
+		{{ MakeKernels<false, false>(BounceSequence()), MakeKernels<false, true>(BounceSequence()) }},
+		{{ MakeKernels<true, false>(BounceSequence()), MakeKernels<true, true>(BounceSequence()) }}
+	}};
+
+	m_RayGen = kernels[hasEmission][allSpecular][bounces - 1];
+}
+
+void Renderer::SetFocusPoint(uint32_t x, uint32_t y)
+{
+	m_HasFocusPoint = true;
+	m_FocusX = x;
+	m_FocusY = y;
+}
+
+void Renderer::BuildTiles(uint32_t viewIndex, bool useRegions)
+{
+	const RenderTarget& target = *m_Views[viewIndex].Target;
+	uint32_t width = target.Width;
+	uint32_t height = target.Height;
+	uint32_t tileSize = std::max(m_Settings.TileSize, 8u);
+
+	uint32_t minX = 0;
+	uint32_t minY = 0;
+	uint32_t maxX = width;
+	uint32_t maxY = height;
+
+	if (useRegions && m_Settings.UseCropRegion)
+	{
+		const Region& crop = m_Settings.CropRegion;
+		minX = std::min(crop.X, width);
+		minY = std::min(crop.Y, height);
+		maxX = std::min(crop.X + crop.Width, width);
+		maxY = std::min(crop.Y + crop.Height, height);
+	}
+
+	bool hasFocus = useRegions && m_HasFocusPoint && m_FocusX < width && m_FocusY < height;
+	float focusX = hasFocus ? (float)m_FocusX : 0.5f * (float)(minX + maxX);
+	float focusY = hasFocus ? (float)m_FocusY : 0.5f * (float)(minY + maxY);
+	float radius = (float)m_Settings.FocusRadius;
+
+	if (hasFocus && m_Settings.FocusRegionOnly)
+	{
+		minX = std::max(minX, (uint32_t)std::max(focusX - radius, 0.0f));
+		minY = std::max(minY, (uint32_t)std::max(focusY - radius, 0.0f));
+		maxX = std::min(maxX, (uint32_t)(focusX + radius) + 1);
+		maxY = std::min(maxY, (uint32_t)(focusY + radius) + 1);
+	}
+
+	if (minX >= maxX || minY >= maxY)
+		return;
+
+	// Tiles stay on the same grid regardless of the region, so accumulated tiles line up between passes
+	struct PrioritizedTile
+	{
+		Tile Bounds;
+		bool InFocus = false;
+		int32_t Ring = 0;
+		float Angle = 0.0f;
+	};
+
+	std::vector<PrioritizedTile> tiles;
+
+	int32_t focusTileX = (int32_t)(focusX / (float)tileSize);
+	int32_t focusTileY = (int32_t)(focusY / (float)tileSize);
+
+	for (uint32_t tileY = minY / tileSize * tileSize; tileY < maxY; tileY += tileSize)
+	{
+		for (uint32_t tileX = minX / tileSize * tileSize; tileX < maxX; tileX += tileSize)
+		{
+			PrioritizedTile& tile = tiles.emplace_back();
+			tile.Bounds.ViewIndex = viewIndex;
+			tile.Bounds.X = std::max(tileX, minX);
+			tile.Bounds.Y = std::max(tileY, minY);
+			tile.Bounds.Width = std::min(tileX + tileSize, maxX) - tile.Bounds.X;
+			tile.Bounds.Height = std::min(tileY + tileSize, maxY) - tile.Bounds.Y;
+
+			// Distance from the focus point to the closest point of the tile
+			float dx = std::max({ (float)tile.Bounds.X - focusX, 0.0f, focusX - (float)(tile.Bounds.X + tile.Bounds.Width) });
+			float dy = std::max({ (float)tile.Bounds.Y - focusY, 0.0f, focusY - (float)(tile.Bounds.Y + tile.Bounds.Height) });
+			tile.InFocus = hasFocus && dx * dx + dy * dy <= radius * radius;
+
+			int32_t offsetX = (int32_t)(tileX / tileSize) - focusTileX;
+			int32_t offsetY = (int32_t)(tileY / tileSize) - focusTileY;
+			tile.Ring = std::max(std::abs(offsetX), std::abs(offsetY));
+			tile.Angle = std::atan2((float)offsetY, (float)offsetX);
+		}
+	}
+
+	if (useRegions && m_Settings.PrioritizeFocus)
+	{
+		std::sort(tiles.begin(), tiles.end(), [](const PrioritizedTile& a, const PrioritizedTile& b)
+		{
+			if (a.InFocus != b.InFocus)
+				return a.InFocus;
+
+			if (a.Ring != b.Ring)
+				return a.Ring < b.Ring;
+
+			return a.Angle < b.Angle;
+		});
+	}
+
+	m_Tiles.reserve(m_Tiles.size() + tiles.size());
+	for (auto& tile : tiles)
+	{
+		tile.Bounds.InFocus = tile.InFocus;
+		m_Tiles.push_back(tile.Bounds);
+	}
+}
+
+void Renderer::OnFrameTime(uint64_t microseconds)
+{
+	if (m_Settings.UseFrameBudget)
+		m_FrameBudget.Update(microseconds, m_PassPixelSamples);
 }
 
-void Renderer::RenderCommon(uint32_t y)
+void Renderer::PlanPass()
 {
-	for (uint32_t x = 0; x < m_Image->GetWidth(); x++)
+	uint64_t pixels = 0;
+	for (const auto& tile : m_Tiles)
+		pixels += tile.Width * tile.Height;
+
+	m_PassSamples = std::max(m_Settings.SamplesPerPass, 1u);
+	m_PassFocusSamples = m_PassSamples;
+
+	if (!m_Settings.UseFrameBudget || pixels == 0)
+	{
+		if (m_Settings.PrioritizeFocus)
+			m_PassFocusSamples = m_PassSamples * std::max(m_Settings.FocusSampleScale, 1u);
+
+		m_PassTileCount = (uint32_t)m_Tiles.size();
+		m_PassPixelSamples = 0;
+		for (const auto& tile : m_Tiles)
+			m_PassPixelSamples += (uint64_t)tile.Width * tile.Height * (tile.InFocus ? m_PassFocusSamples : m_PassSamples);
+
+		return;
+	}
+
+	// The budget decides the samples of the pass on its own, it gives tiles in focus a larger share
+	// of the passes instead of more samples
+	m_PassSamples = 1;
+	m_PassFocusSamples = 1;
+
+	m_FrameBudget.SetTargetFrameTime(m_Settings.TargetFrameTime);
+	uint64_t budget = m_FrameBudget.GetPixelSamples();
+
+	// Enough headroom for the whole frame, spend the rest on extra samples
+	if (budget >= pixels)
+	{
+		constexpr uint64_t maxSamplesPerPass = 64;
+
+		m_PassSamples = (uint32_t)std::min(budget / pixels, maxSamplesPerPass);
+		m_PassFocusSamples = m_PassSamples;
+		m_PassTileCount = (uint32_t)m_Tiles.size();
+		m_PassPixelSamples = pixels * m_PassSamples;
+		return;
+	}
+
+	// Not enough time for the whole frame, the least converged tiles go first. Tiles around the
+	// focus point count as less converged so they get a larger share of the passes.
+	const RenderTarget& target = m_Target;
+	auto getPriority = [&target](const Tile& tile)
+	{
+		uint32_t index = tile.Y * target.Width + tile.X;
+		uint32_t samples = target.PixelEpoch[index] == target.Epoch ? target.SampleCount[index] : 0;
+
+		return tile.InFocus ? samples : samples * 4;
+	};
+
+	std::stable_sort(m_Tiles.begin(), m_Tiles.end(), [&getPriority](const Tile& a, const Tile& b)
 	{
-		glm::vec3 color = RayGen(x, y);
-		m_AccumulatedColorData[y * m_Image->GetWidth() + x] += color;
+		return getPriority(a) < getPriority(b);
+	});
 
-		glm::vec3 accumulatedColor = m_AccumulatedColorData[y * m_Image->GetWidth() + x];
-		accumulatedColor /= (float)m_FrameIndex;
-		accumulatedColor = glm::clamp(accumulatedColor, 0.0f, 1.0f);
+	m_PassTileCount = 0;
+	m_PassPixelSamples = 0;
+	for (const auto& tile : m_Tiles)
+	{
+		uint64_t tilePixels = tile.Width * tile.Height;
+		if (m_PassTileCount > 0 && m_PassPixelSamples + tilePixels > budget)
+			break;
 
-		m_ImageData[y * m_Image->GetWidth() + x] = Utils::ConvertToRGBA(glm::vec4(accumulatedColor, 1.0f));
+		m_PassPixelSamples += tilePixels;
+		m_PassTileCount++;
 	}
+
+	m_Tiles.resize(m_PassTileCount);
 }
 
-void Renderer::RenderST()
+void Renderer::RenderTile(const Tile& tile, bool resolve)
 {
-	for (uint32_t y = 0; y < m_Image->GetHeight(); y++)
+	const RenderView& view = m_Views[tile.ViewIndex];
+	RenderTarget& target = *view.Target;
+	uint32_t width = target.Width;
+	uint32_t samples = tile.InFocus ? m_PassFocusSamples : m_PassSamples;
+
+	for (uint32_t y = tile.Y; y < tile.Y + tile.Height; y++)
+	{
+		for (uint32_t x = tile.X; x < tile.X + tile.Width; x++)
+		{
+			uint32_t index = y * width + x;
+
+			// Resetting only clears the pixels we render, anything outside the active region keeps its last image
+			if (target.PixelEpoch[index] != target.Epoch)
+			{
+				target.AccumulatedColor[index] = glm::vec3(0.0f);
+				target.SampleCount[index] = 0;
+				target.PixelEpoch[index] = target.Epoch;
+			}
+
+			// All samples of the pass are summed locally, the target is only written once per pixel
+			uint32_t firstSample = target.SampleCount[index] + 1;
+			glm::vec3 color(0.0f);
+			for (uint32_t sample = 0; sample < samples; sample++)
+				color += (this->*m_RayGen)(view, x, y, firstSample + sample);
+
+			target.AccumulatedColor[index] += color;
+			target.SampleCount[index] += samples;
+
+			if (resolve)
+				target.ImageData[index] = Utils::ResolvePixel(target.AccumulatedColor[index], target.SampleCount[index]);
+		}
+	}
+}
+
+void Renderer::RenderST(bool resolve)
+{
+	for (const auto& tile : m_Tiles)
 	{
-		RenderCommon(y);
+		RenderTile(tile, resolve);
 	}
 }
 
-void Renderer::RenderMT()
+void Renderer::RenderMT(bool resolve)
 {
-	// TODO: Find solution that is platform agnostic
-	#ifdef EPPO_WINDOWS
-		std::for_each(std::execution::par, m_VerticalIterator.begin(), m_VerticalIterator.end(), [this](uint32_t y)
+	// Workers pick up tiles in order, so the highest priority tiles finish first. With multiple views
+	// the workers simply continue with the next view, there is no sync point in between.
+	m_ThreadPool->ParallelFor((uint32_t)m_Tiles.size(), [this, resolve](uint32_t i)
+	{
+		RenderTile(m_Tiles[i], resolve);
+	});
+}
+
+void Renderer::ResolveImage(RenderTarget& target)
+{
+	m_ThreadPool->ParallelFor(target.Height, [&target](uint32_t y)
+	{
+		for (uint32_t index = y * target.Width; index < (y + 1) * target.Width; index++)
 		{
-			RenderCommon(y);
-		});
-	#endif
+			// Pixels from before a reset keep their last image, like they do when resolving per tile
+			if (target.PixelEpoch[index] == target.Epoch)
+				target.ImageData[index] = Utils::ResolvePixel(target.AccumulatedColor[index], target.SampleCount[index]);
+		}
+	});
 }
 
 void Renderer::RenderGPU()
@@ -157,27 +633,27 @@ void Renderer::RenderGPU()
 	m_CameraData.InverseView = m_ActiveCamera->GetInverseView();
 	m_CameraData.Projection = m_ActiveCamera->GetProjection();
 	m_CameraData.InverseProjection = m_ActiveCamera->GetInverseProjection();
-	m_CameraData.Position = glm::vec4(m_ActiveCamera->GetPosition(), (float)m_FrameIndex);
+	m_CameraData.Position = glm::vec4(m_ActiveCamera->GetPosition(), (float)m_Target.FrameIndex);
 	m_CameraData.Direction = glm::vec4(m_ActiveCamera->GetDirection(), 0.0);
 
 	m_CameraUB->SetData(&m_CameraData, sizeof(CameraData));
 
 	// Update sphere storage
 	{
-		uint32_t size = m_ActiveScene->m_Spheres.size() * sizeof(Sphere);
+		uint32_t size = m_ActiveScene->m_Spheres->size() * sizeof(Sphere);
 		if (!m_SphereSB || size != m_SphereSB->GetSize())
 			m_SphereSB = std::make_shared<Eppo::Buffer>(size, 1);
 
-		m_SphereSB->SetData((void*)m_ActiveScene->m_Spheres.data(), size);
+		m_SphereSB->SetData((void*)m_ActiveScene->m_Spheres->data(), size);
 	}
 
 	// Update material storage
 	{
-		uint32_t size = m_ActiveScene->m_Materials.size() * sizeof(Material);
+		uint32_t size = m_ActiveScene->m_Materials->size() * sizeof(Material);
 		if (!m_MaterialSB || size != m_MaterialSB->GetSize())
 			m_MaterialSB = std::make_shared<Eppo::Buffer>(size, 2);
 
-		m_MaterialSB->SetData((void*)m_ActiveScene->m_Materials.data(), size);
+		m_MaterialSB->SetData((void*)m_ActiveScene->m_Materials->data(), size);
 	}
 
 	// Dispatch compute shader
@@ -201,110 +677,219 @@ void Renderer::RenderGPU()
 		for (uint32_t x = 0; x < m_Image->GetWidth(); x++)
 		{
 			glm::vec4 color = data[y * m_Image->GetWidth() + x];
-			m_AccumulatedColorData[y * m_Image->GetWidth() + x] += glm::vec3(color.r, color.g, color.b);
 
-			glm::vec3 accumulatedColor = m_AccumulatedColorData[y * m_Image->GetWidth() + x];
-			accumulatedColor /= (float)m_FrameIndex;
-			accumulatedColor = glm::clamp(accumulatedColor, 0.0f, 1.0f);
+			if (m_Target.PixelEpoch[y * m_Image->GetWidth() + x] != m_Target.Epoch)
+			{
+				m_Target.AccumulatedColor[y * m_Image->GetWidth() + x] = glm::vec3(0.0f);
+				m_Target.SampleCount[y * m_Image->GetWidth() + x] = 0;
+				m_Target.PixelEpoch[y * m_Image->GetWidth() + x] = m_Target.Epoch;
+			}
 
-			m_ImageData[y * m_Image->GetWidth() + x] = Utils::ConvertToRGBA(glm::vec4(accumulatedColor, 1.0f));
+			m_Target.AccumulatedColor[y * m_Image->GetWidth() + x] += glm::vec3(color.r, color.g, color.b);
+			m_Target.SampleCount[y * m_Image->GetWidth() + x]++;
+
+			m_Target.ImageData[y * m_Image->GetWidth() + x] = Utils::ResolvePixel(m_Target.AccumulatedColor[y * m_Image->GetWidth() + x], m_Target.SampleCount[y * m_Image->GetWidth() + x]);
 		}
 	}
 
 	m_PixelSB->UnmapBuffer();
 }
 
-glm::vec3 Renderer::RayGen(uint32_t x, uint32_t y) const
+template<bool HasEmission, bool AllSpecular, uint32_t Bounces>
+glm::vec3 Renderer::RayGen(const RenderView& view, uint32_t x, uint32_t y, uint32_t sampleIndex) const
 {
-	Ray ray;
-	ray.Origin = m_ActiveCamera->GetPosition();
-	ray.Direction = m_ActiveCamera->GetRayDirection(x, y);
-
-	glm::vec3 light(0.0f);
-	glm::vec3 contribution(1.0f);
+	// Light only ever comes from emissive materials, without them every path ends up black
+	if constexpr (!HasEmission)
+	{
+		return glm::vec3(0.0f);
+	} else
+	{
+		Ray ray;
+		ray.Origin = view.ViewCamera->GetPosition();
+		ray.Direction = view.ViewCamera->GetRayDirection(x, y);
+
+		// The cone starts out as wide as the angle between neighbouring pixels
+		RayCone cone;
+		uint32_t neighbourX = x + 1 < view.Target->Width ? x + 1 : x - 1;
+		if (view.Target->Width > 1)
+			cone.Spread = glm::length(view.ViewCamera->GetRayDirection(neighbourX, y) - ray.Direction);
+
+		glm::vec3 light(0.0f);
+		glm::vec3 contribution(1.0f);
+
+		uint32_t seed = y * view.Target->Width + x;
+		seed *= sampleIndex;
+
+		// Rough vertices of this path, they are trained with the light found after them divided by the
+		// contribution up to them
+		bool useGuiding = m_Settings.UsePathGuiding && !m_PathGuide.IsEmpty();
+		std::array<uint32_t, Bounces> guideCells;
+		std::array<glm::vec3, Bounces> guideDirections;
+		std::array<float, Bounces> guideLight;
+		std::array<float, Bounces> guideWeights;
+		uint32_t guideVertices = 0;
+
+		for (uint32_t i = 0; i < Bounces; i++)
+		{
+			seed += i;
 
-	uint32_t seed = y * m_Image->GetWidth() + x;
-	seed *= m_FrameIndex;
+			HitPayload payload = TraceRay(ray, cone, m_Settings.UseLOD && i >= m_Settings.LODMinBounce);
 
-	uint32_t bounces = 5;
-	for (uint32_t i = 0; i < bounces; i++)
-	{
-		seed += i;
+			if (payload.HitDistance < 0.0f)
+			{
+				glm::vec3 skyColor = Utils::Lerp(glm::vec3(1.0f), glm::vec3(0.5f, 0.7f, 1.0f), ray.Direction.y);
+				//light += skyColor;
+				break;
+			}
 
-		HitPayload payload = TraceRay(ray);
+			const Material& material = *payload.HitMaterial;
 
-		if (payload.HitDistance < 0.0f)
-		{
-			glm::vec3 skyColor = Utils::Lerp(glm::vec3(1.0f), glm::vec3(0.5f, 0.7f, 1.0f), ray.Direction.y);
-			//light += skyColor;
-			break;
-		}
+			// Emitted light only passes through the surfaces before it
+			light += contribution * material.Emission * material.EmissionPower;
+			contribution *= material.Albedo;
 
-		const Sphere& sphere = m_ActiveScene->m_Spheres[payload.ObjectIndex];
-		const Material& material = m_ActiveScene->m_Materials[sphere.MaterialIndex];
+			cone.Width += cone.Spread * payload.HitDistance;
+			if constexpr (!AllSpecular)
+				cone.Spread += material.Roughness;
 
-		contribution *= material.Albedo;
-		light += material.Emission * material.EmissionPower;
-		
-		// Importance sampling
-		glm::vec3 microFacetDirection = payload.WorldNormal + material.Roughness * Eppo::FastRandom::InUnitSphere(seed);
-		float weight = glm::dot(microFacetDirection, payload.WorldNormal);
-		microFacetDirection *= weight;
+			ray.Origin = payload.WorldPosition + payload.WorldNormal * 0.0001f;
 
-		ray.Origin = payload.WorldPosition + payload.WorldNormal * 0.0001f;
-		ray.Direction = glm::reflect(ray.Direction, microFacetDirection);
-		//ray.Direction = glm::normalize(payload.WorldNormal + Eppo::FastRandom::InUnitSphere(seed));
-	}
+			if constexpr (AllSpecular)
+			{
+				// Zero roughness leaves the microfacet normal equal to the surface normal
+				ray.Direction = glm::reflect(ray.Direction, payload.WorldNormal);
+			} else
+			{
+				glm::vec3 reflected = glm::reflect(ray.Direction, payload.WorldNormal);
+				float exponent = Utils::GetLobeExponent(material.Roughness);
+
+				// Guiding only changes how directions are picked, the material responds the same either way
+				bool guided = useGuiding && material.Roughness > 0.0f && material.Roughness >= m_Settings.GuidingMinRoughness;
+				uint32_t cell = guided ? m_PathGuide.Lookup(payload.WorldPosition) : 0;
+				float guideFraction = guided && m_PathGuide.IsTrained(cell) ? m_Settings.GuidingFraction : 0.0f;
+
+				if (material.Roughness <= 0.0f)
+					ray.Direction = reflected;
+				else if (guideFraction > 0.0f && Utils::RandomFloat(seed) < guideFraction)
+					ray.Direction = m_PathGuide.Sample(cell, Utils::RandomFloat(seed), Utils::RandomFloat(seed), Utils::RandomFloat(seed));
+				else
+					ray.Direction = Utils::SampleLobe(reflected, exponent, Utils::RandomFloat(seed), Utils::RandomFloat(seed));
+
+				// One sample MIS of the guide against the material lobe. Guide directions outside the
+				// lobe don't receive any light from the material.
+				if (guideFraction > 0.0f)
+				{
+					float materialPdf = Utils::GetLobePdf(reflected, exponent, ray.Direction);
+					float mixturePdf = guideFraction * m_PathGuide.Pdf(cell, ray.Direction) + (1.0f - guideFraction) * materialPdf;
+					if (materialPdf <= 0.0f || mixturePdf <= 0.0f)
+						break;
+
+					contribution *= materialPdf / mixturePdf;
+				}
+
+				if (guided)
+				{
+					guideCells[guideVertices] = cell;
+					guideDirections[guideVertices] = ray.Direction;
+					guideLight[guideVertices] = Utils::Luminance(light);
+					guideWeights[guideVertices] = Utils::Luminance(contribution);
+					guideVertices++;
+				}
+			}
+		}
 
-	// Gamma correction
-	light = glm::pow(light, glm::vec3(1.0f / 2.2f));
+		for (uint32_t i = 0; i < guideVertices; i++)
+		{
+			float radiance = guideWeights[i] > 0.0f ? (Utils::Luminance(light) - guideLight[i]) / guideWeights[i] : 0.0f;
+			m_PathGuide.Record(guideCells[i], guideDirections[i], radiance);
+		}
 
-	return light * contribution;
+		return light;
+	}
 }
 
-Renderer::HitPayload Renderer::TraceRay(const Ray& ray) const
+Renderer::HitPayload Renderer::TraceRay(const Ray& ray, const RayCone& cone, bool useLOD) const
 {
-	int closestSphere = -1;
+	const auto& nodes = m_Hierarchy.GetNodes();
+	const auto& sphereIndices = m_Hierarchy.GetSphereIndices();
+	const auto& spheres = *m_ActiveScene->m_Spheres;
+
+	if (nodes.empty())
+		return Miss();
+
+	uint32_t closestObject = UINT32_MAX;
 	float closestHit = FLT_MAX;
 
-	for (size_t i = 0; i < m_ActiveScene->m_Spheres.size(); i++)
+	glm::vec3 inverseDirection = 1.0f / ray.Direction;
+
+	// The hierarchy is balanced, so this is deep enough for any sphere count we can index
+	uint32_t stack[64];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
 	{
-		const auto& sphere = m_ActiveScene->m_Spheres[i];
+		uint32_t nodeIndex = stack[--stackSize];
+		const SphereHierarchy::Node& node = nodes[nodeIndex];
 
-		glm::vec3 origin = ray.Origin - sphere.Position;
+		float entry;
+		if (!Utils::IntersectBounds(ray, inverseDirection, node.BoundsMin, node.BoundsMax, closestHit, entry))
+			continue;
 
-		// (bx^2 + by^2)t^2 + (2(axbx + ayby))t + (ax^2 + ay^2 - r^2) = 0
-		// where
-		// a = ray origin
-		// b = ray direction
-		// r = radius
-		// t = hit distance
-		float a = glm::dot(ray.Direction, ray.Direction);
-		float b = 2.0f * glm::dot(origin, ray.Direction);
-		float c = glm::dot(origin, origin) - sphere.Radius * sphere.Radius;
+		// Clusters smaller than the ray footprint are traced as their proxy. Nodes that contain the
+		// ray origin are always opened, otherwise the proxy would swallow the surface we came from.
+		if (useLOD && entry > 0.0f && 2.0f * node.ProxyRadius < (cone.Width + cone.Spread * entry) * m_Settings.LODThreshold)
+		{
+			float t = Utils::IntersectSphere(ray, node.ProxyPosition, node.ProxyRadius);
+			if (t < closestHit && t > 0.0f)
+			{
+				closestHit = t;
+				closestObject = nodeIndex | ProxyObjectFlag;
+			}
 
-		// Quadratic forumula discriminant:
-		// b^2 - 4ac
-		float discriminant = b * b - 4.0f * a * c;
-		if (discriminant < 0)
 			continue;
+		}
 
-		// Quadratic formula:
-		// (-b +- sqrt(discriminant)) / 2a
-		
-		//float t1 = (-b + sqrtD) / (2.0f * a);
-		float closestT = (-b - glm::sqrt(discriminant)) / (2.0f * a);
-		if (closestT < closestHit && closestT > 0.0f)
+		if (node.IsLeaf())
 		{
-			closestHit = closestT;
-			closestSphere = i;
+			for (uint32_t i = node.First; i < node.First + node.Count; i++)
+			{
+				uint32_t sphereIndex = sphereIndices[i];
+				const auto& sphere = spheres[sphereIndex];
+
+				float t = Utils::IntersectSphere(ray, sphere.Position, sphere.Radius);
+				if (t < closestHit && t > 0.0f)
+				{
+					closestHit = t;
+					closestObject = sphereIndex;
+				}
+			}
+
+			continue;
+		}
+
+		// Visit the closer child first so the far one can be culled by the closest hit
+		const SphereHierarchy::Node& left = nodes[node.First];
+		const SphereHierarchy::Node& right = nodes[node.First + 1];
+
+		glm::vec3 leftOffset = 0.5f * (left.BoundsMin + left.BoundsMax) - ray.Origin;
+		glm::vec3 rightOffset = 0.5f * (right.BoundsMin + right.BoundsMax) - ray.Origin;
+
+		if (glm::dot(leftOffset, leftOffset) < glm::dot(rightOffset, rightOffset))
+		{
+			stack[stackSize++] = node.First + 1;
+			stack[stackSize++] = node.First;
+		} else
+		{
+			stack[stackSize++] = node.First;
+			stack[stackSize++] = node.First + 1;
 		}
 	}
 
-	if (closestSphere < 0)
+	if (closestObject == UINT32_MAX)
 		return Miss();
 
-	return ClosestHit(ray, closestHit, closestSphere);
+	return ClosestHit(ray, closestHit, closestObject);
 }
 
 Renderer::HitPayload Renderer::ClosestHit(const Ray& ray, float hitDistance, uint32_t objectIndex) const
@@ -313,13 +898,24 @@ Renderer::HitPayload Renderer::ClosestHit(const Ray& ray, float hitDistance, uin
 	payload.HitDistance = hitDistance;
 	payload.ObjectIndex = objectIndex;
 
-	const Sphere& closestSphere = m_ActiveScene->m_Spheres[objectIndex];
+	glm::vec3 position;
+	if (objectIndex & ProxyObjectFlag)
+	{
+		uint32_t nodeIndex = objectIndex & ~ProxyObjectFlag;
+		position = m_Hierarchy.GetNodes()[nodeIndex].ProxyPosition;
+		payload.HitMaterial = &m_Hierarchy.GetProxyMaterials()[nodeIndex];
+	} else
+	{
+		const Sphere& closestSphere = (*m_ActiveScene->m_Spheres)[objectIndex];
+		position = closestSphere.Position;
+		payload.HitMaterial = &(*m_ActiveScene->m_Materials)[closestSphere.MaterialIndex];
+	}
 
-	glm::vec3 origin = ray.Origin - closestSphere.Position;
+	glm::vec3 origin = ray.Origin - position;
 	payload.WorldPosition = origin + ray.Direction * hitDistance;
 	payload.WorldNormal = glm::normalize(payload.WorldPosition);
 
-	payload.WorldPosition += closestSphere.Position;
+	payload.WorldPosition += position;
 
 	return payload;
 }
@@ -2,12 +2,21 @@
 
 #include <EppoCore.h>
 #include "RT/Camera.h"
+#include "RT/FrameBudget.h"
+#include "RT/PathGuide.h"
 #include "RT/Ray.h"
+#include "RT/RenderTarget.h"
 #include "RT/Scene.h"
+#include "RT/SceneStore.h"
+#include "RT/SphereHierarchy.h"
+#include "RT/ThreadPool.h"
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <array>
 #include <memory>
+#include <utility>
 
 class Renderer
 {
@@ -19,28 +28,112 @@ public:
 		Gpu
 	};
 
+	struct Region
+	{
+		uint32_t X = 0;
+		uint32_t Y = 0;
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+	};
+
 	struct Settings
 	{
 		bool Accumulate = true;
 		RenderMode Mode;
+		uint32_t Bounces = 5;
 		uint64_t LastRenderTime = 0;
+
+		uint32_t TileSize = 32;
+
+		// Every pass takes this many samples per pixel, the image is resolved and uploaded every
+		// DisplayInterval passes. Both trade responsiveness for throughput.
+		uint32_t SamplesPerPass = 1;
+		uint32_t DisplayInterval = 1;
+
+		// Only pixels inside the crop region are rendered, the rest keeps its last image
+		bool UseCropRegion = false;
+		Region CropRegion;
+
+		// Tiles around the focus point are rendered first, the rest spirals outwards. Without the frame
+		// budget a pass always covers every tile, so prioritized tiles take FocusSampleScale times the
+		// samples of the pass instead and converge first.
+		bool PrioritizeFocus = true;
+		uint32_t FocusSampleScale = 4;
+		bool FocusRegionOnly = false;
+		uint32_t FocusRadius = 128;
+
+		// Clusters smaller than the ray footprint times the threshold are traced as a single proxy sphere
+		bool UseLOD = false;
+		float LODThreshold = 1.0f;
+		uint32_t LODMinBounce = 1;
+
+		// Adapts the tiles and samples of every pass so rendering it takes the target time. The target
+		// only covers rendering, the default leaves room for the UI and presenting in a 60 Hz frame.
+		bool UseFrameBudget = false;
+		float TargetFrameTime = 12.0f;
+
+		// Rough bounces sample part of their directions from a cache learned from earlier passes.
+		// Only materials from the minimum roughness up are guided, narrow lobes gain nothing from it.
+		bool UsePathGuiding = false;
+		float GuidingFraction = 0.5f;
+		float GuidingMinRoughness = 0.3f;
+	};
+
+	// The camera must have been resized to the size of its target
+	struct RenderView
+	{
+		const Camera* ViewCamera = nullptr;
+		RenderTarget* Target = nullptr;
 	};
 
+public:
+	// The path guide only learns between passes, so offline renders with guiding split their samples
+	// over at least this many passes
+	static constexpr uint32_t GuidedPassCount = 16;
+
 public:
 	Renderer() = default;
 
+	// Renderers that are alive at the same time can share their workers
+	explicit Renderer(std::shared_ptr<ThreadPool> threadPool)
+		: m_ThreadPool(std::move(threadPool))
+	{}
+
 	void Init();
 
 	void OnResize(uint32_t width, uint32_t height);
-	void Render(const Scene& scene, const Camera& camera, RenderMode mode);
+	// Without regions the pass covers the whole image, regardless of the crop and cursor settings
+	void Render(const Scene& scene, const Camera& camera, RenderMode mode, bool useRegions = true);
+
+	// Renders all views in one go on the CPU, tiles of every view share the same workers
+	void RenderViews(const Scene& scene, const std::vector<RenderView>& views);
+
+	// Pins the current version of the scene for the pass, editors can publish new versions meanwhile
+	void Render(const SceneStore& store, const Camera& camera, RenderMode mode);
+	void RenderViews(const SceneStore& store, const std::vector<RenderView>& views);
 
 	Settings& GetSettings() { return m_Settings; }
 
-	uint32_t GetFrameIndex() const { return m_FrameIndex; }
-	void ResetFrameIndex() { m_FrameIndex = 1; }
+	// Spheres or materials were edited, a rebuild is only needed when the scene changed a lot
+	void OnSceneChanged(bool rebuild = false);
+
+	uint32_t GetFrameIndex() const { return m_Target.FrameIndex; }
+	void ResetFrameIndex() { m_Target.Reset(); }
+
+	// Measured time of the last Render call, drives the frame budget
+	void OnFrameTime(uint64_t microseconds);
+	uint32_t GetPassTileCount() const { return m_PassTileCount; }
+	uint32_t GetPassSamples() const { return m_PassSamples; }
+
+	uint32_t GetPathGuideCellCount() const { return m_PathGuide.GetCellCount(); }
+
+	// Usually the cursor position in the viewport, in image pixels
+	void SetFocusPoint(uint32_t x, uint32_t y);
+	void ClearFocusPoint() { m_HasFocusPoint = false; }
 
 	const std::shared_ptr<Eppo::Image>& GetImage() const { return m_Image; }
-	uint32_t* GetImageData() const { return m_ImageData; }
+	const std::shared_ptr<ThreadPool>& GetThreadPool() const { return m_ThreadPool; }
+	const RenderTarget& GetRenderTarget() const { return m_Target; }
 
 	uint32_t GetViewportWidth() const { return m_ViewportWidth; }
 	uint32_t GetViewportHeight() const { return m_ViewportHeight; }
@@ -53,16 +146,47 @@ private:
 		glm::vec3 WorldNormal;
 
 		uint32_t ObjectIndex;
+		const Material* HitMaterial = nullptr;
+	};
+
+	// Set on the object index of a hit when it was a proxy, the rest is the node index
+	static constexpr uint32_t ProxyObjectFlag = 0x80000000;
+
+	// Kernels are specialized per scene feature set, see SelectKernel
+	using RayGenFn = glm::vec3(Renderer::*)(const RenderView& view, uint32_t x, uint32_t y, uint32_t sampleIndex) const;
+	static constexpr uint32_t MaxBounces = 8;
+
+	template<bool HasEmission, bool AllSpecular, size_t... Bounces>
+	static constexpr std::array<RayGenFn, sizeof...(Bounces)> MakeKernels(std::index_sequence<Bounces...>);
+	void SelectKernel();
+
+	struct Tile
+	{
+		uint32_t X = 0;
+		uint32_t Y = 0;
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+
+		uint32_t ViewIndex = 0;
+		bool InFocus = false;
 	};
 
-	void RenderCommon(uint32_t y);
-	void RenderST();
-	void RenderMT();
+	void UpdateHierarchy();
+	void UpdatePathGuide();
+	void BuildTiles(uint32_t viewIndex, bool useRegions);
+	void PlanPass();
+	void AdvanceFrame(RenderTarget& target) const;
+
+	void RenderTile(const Tile& tile, bool resolve);
+	void RenderST(bool resolve);
+	void RenderMT(bool resolve);
+	void ResolveImage(RenderTarget& target);
 	void RenderGPU();
 
-	glm::vec3 RayGen(uint32_t x, uint32_t y) const;
+	template<bool HasEmission, bool AllSpecular, uint32_t Bounces>
+	glm::vec3 RayGen(const RenderView& view, uint32_t x, uint32_t y, uint32_t sampleIndex) const;
 
-	HitPayload TraceRay(const Ray& ray) const;
+	HitPayload TraceRay(const Ray& ray, const RayCone& cone, bool useLOD) const;
 	HitPayload ClosestHit(const Ray& ray, float hitDistance, uint32_t objectIndex) const;
 	HitPayload Miss() const;
 
@@ -75,7 +199,7 @@ private:
 	std::shared_ptr<Eppo::Buffer> m_MaterialSB;
 
 	std::shared_ptr<Eppo::Image> m_Image;
-	uint32_t* m_ImageData = nullptr;
+	RenderTarget m_Target;
 
 	struct CameraData
 	{
@@ -88,14 +212,35 @@ private:
 	} m_CameraData;
 	std::shared_ptr<Eppo::UniformBuffer> m_CameraUB;
 
-	glm::vec3* m_AccumulatedColorData = nullptr;
-	uint32_t m_FrameIndex = 1;
-
 	const Camera* m_ActiveCamera = nullptr;
 	const Scene* m_ActiveScene = nullptr;
+	RayGenFn m_RayGen = nullptr;
+
+	SphereHierarchy m_Hierarchy;
+	const Scene* m_HierarchyScene = nullptr;
+	bool m_HierarchyDirty = false;
+	bool m_RebuildHierarchy = false;
+	uint64_t m_SceneVersion = 0;
+
+	PathGuide m_PathGuide;
+	bool m_PathGuideDirty = true;
+	uint32_t m_PathGuidePasses = 0;
 
 	uint32_t m_ViewportWidth = 0;
 	uint32_t m_ViewportHeight = 0;
 
-	std::vector<uint32_t> m_VerticalIterator;
+	std::vector<RenderView> m_Views;
+	std::vector<Tile> m_Tiles;
+	std::shared_ptr<ThreadPool> m_ThreadPool = std::make_shared<ThreadPool>();
+
+	FrameBudget m_FrameBudget;
+	uint64_t m_PassPixelSamples = 0;
+	uint32_t m_PassTileCount = 0;
+	uint32_t m_PassSamples = 1;
+	uint32_t m_PassFocusSamples = 1;
+	uint32_t m_PassesSinceDisplay = 0;
+
+	bool m_HasFocusPoint = false;
+	uint32_t m_FocusX = 0;
+	uint32_t m_FocusY = 0;
 };
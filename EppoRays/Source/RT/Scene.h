@@ -2,6 +2,7 @@
 
 #include <glm/glm.hpp>
 
+#include <memory>
 #include <vector>
 
 struct alignas(16) Sphere
@@ -21,8 +22,24 @@ struct alignas(16) Material
 	float EmissionPower = 0.0f;
 };
 
+// Copies of a scene share their sphere and material arrays. Editing one of the arrays detaches it from
+// the other copies first, so publishing a version that only moved a sphere leaves the materials shared.
 struct Scene
 {
-	std::vector<Sphere> m_Spheres;
-	std::vector<Material> m_Materials;
+	std::shared_ptr<const std::vector<Sphere>> m_Spheres = std::make_shared<std::vector<Sphere>>();
+	std::shared_ptr<const std::vector<Material>> m_Materials = std::make_shared<std::vector<Material>>();
+
+	std::vector<Sphere>& EditSpheres() { return Detach(m_Spheres); }
+	std::vector<Material>& EditMaterials() { return Detach(m_Materials); }
+
+private:
+	template<typename T>
+	static std::vector<T>& Detach(std::shared_ptr<const std::vector<T>>& items)
+	{
+		// Arrays are always created mutable, one that no other copy holds can be changed in place
+		if (items.use_count() != 1)
+			items = std::make_shared<std::vector<T>>(*items);
+
+		return const_cast<std::vector<T>&>(*items);
+	}
 };
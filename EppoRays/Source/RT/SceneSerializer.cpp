@@ -0,0 +1,139 @@
+#include "SceneSerializer.h"
+
+#include <fstream>
+#include <sstream>
+
+namespace Utils
+{
+	// Enough digits to read back the exact same float
+	inline static void WriteFloat(std::string& out, float value)
+	{
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), " %.9g", value);
+		out += buffer;
+	}
+
+	inline static void WriteVec3(std::string& out, const glm::vec3& value)
+	{
+		WriteFloat(out, value.x);
+		WriteFloat(out, value.y);
+		WriteFloat(out, value.z);
+	}
+
+	inline static bool ReadVec3(std::istringstream& stream, glm::vec3& value)
+	{
+		return (bool)(stream >> value.x >> value.y >> value.z);
+	}
+}
+
+std::string SceneSerializer::Serialize(const Scene& scene)
+{
+	std::string out;
+	out.reserve(64 * (scene.m_Materials->size() + scene.m_Spheres->size()));
+
+	for (const auto& material : *scene.m_Materials)
+	{
+		out += "material";
+		Utils::WriteVec3(out, material.Albedo);
+		Utils::WriteFloat(out, material.Roughness);
+		Utils::WriteVec3(out, material.Emission);
+		Utils::WriteFloat(out, material.EmissionPower);
+		out += '\n';
+	}
+
+	for (const auto& sphere : *scene.m_Spheres)
+	{
+		out += "sphere";
+		Utils::WriteVec3(out, sphere.Position);
+		Utils::WriteFloat(out, sphere.Radius);
+		out += ' ' + std::to_string(sphere.MaterialIndex) + '\n';
+	}
+
+	return out;
+}
+
+bool SceneSerializer::Deserialize(const std::string& text, Scene& scene, std::string& error)
+{
+	Scene result;
+	std::vector<Material>& materials = result.EditMaterials();
+	std::vector<Sphere>& spheres = result.EditSpheres();
+
+	std::istringstream input(text);
+	std::string line;
+	uint32_t lineNumber = 0;
+
+	while (std::getline(input, line))
+	{
+		lineNumber++;
+
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+			line.resize(comment);
+
+		std::istringstream stream(line);
+		std::string type;
+		if (!(stream >> type))
+			continue;
+
+		bool valid = false;
+		if (type == "material")
+		{
+			Material& material = materials.emplace_back();
+			valid = Utils::ReadVec3(stream, material.Albedo) && (stream >> material.Roughness) && Utils::ReadVec3(stream, material.Emission) && (stream >> material.EmissionPower);
+		} else if (type == "sphere")
+		{
+			Sphere& sphere = spheres.emplace_back();
+			valid = Utils::ReadVec3(stream, sphere.Position) && (stream >> sphere.Radius) && (stream >> sphere.MaterialIndex);
+		} else
+		{
+			error = "Line " + std::to_string(lineNumber) + ": unknown type '" + type + "'";
+			return false;
+		}
+
+		std::string trailing;
+		if (!valid || stream >> trailing)
+		{
+			error = "Line " + std::to_string(lineNumber) + ": malformed " + type;
+			return false;
+		}
+	}
+
+	for (const auto& sphere : spheres)
+	{
+		if (sphere.MaterialIndex >= materials.size())
+		{
+			error = "Sphere uses material " + std::to_string(sphere.MaterialIndex) + " but there are only " + std::to_string(materials.size());
+			return false;
+		}
+	}
+
+	scene = std::move(result);
+	return true;
+}
+
+bool SceneSerializer::LoadFromFile(const std::string& filepath, Scene& scene, std::string& error)
+{
+	std::ifstream file(filepath, std::ios::binary);
+	if (!file)
+	{
+		error = "Could not open '" + filepath + "'";
+		return false;
+	}
+
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+
+	return Deserialize(buffer.str(), scene, error);
+}
+
+uint64_t SceneSerializer::Hash(const std::string& text)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : text)
+	{
+		hash ^= (uint8_t)c;
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "RT/Scene.h"
+
+#include <string>
+
+// Plain text scene description, one object per line and '#' starts a comment:
+//
+//   material <albedo r g b> <roughness> <emission r g b> <emission power>
+//   sphere <position x y z> <radius> <material index>
+//
+// Serializing is canonical, the same scene always produces the same text and floats survive a
+// round trip exactly. That makes a hash of the text usable as the identity of a scene.
+class SceneSerializer
+{
+public:
+	static std::string Serialize(const Scene& scene);
+	static bool Deserialize(const std::string& text, Scene& scene, std::string& error);
+
+	static bool LoadFromFile(const std::string& filepath, Scene& scene, std::string& error);
+
+	// 64-bit FNV-1a
+	static uint64_t Hash(const std::string& text);
+};
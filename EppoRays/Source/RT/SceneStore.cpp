@@ -0,0 +1,118 @@
+#include "SceneStore.h"
+
+#include <algorithm>
+#include <thread>
+
+SceneStore::Snapshot::~Snapshot()
+{
+	Release();
+}
+
+SceneStore::Snapshot::Snapshot(Snapshot&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+SceneStore::Snapshot& SceneStore::Snapshot::operator=(Snapshot&& other) noexcept
+{
+	if (this != &other)
+	{
+		Release();
+
+		m_Store = other.m_Store;
+		m_Scene = other.m_Scene;
+		m_Version = other.m_Version;
+		m_Slot = other.m_Slot;
+
+		other.m_Store = nullptr;
+		other.m_Scene = nullptr;
+	}
+
+	return *this;
+}
+
+void SceneStore::Snapshot::Release()
+{
+	if (!m_Store)
+		return;
+
+	m_Store->m_ReaderEpochs[m_Slot].store(0);
+
+	m_Store = nullptr;
+	m_Scene = nullptr;
+}
+
+SceneStore::SceneStore(Scene scene)
+{
+	m_Current.store(new Version{ std::move(scene), 1 });
+}
+
+SceneStore::~SceneStore()
+{
+	// Snapshots must not outlive the store
+	delete m_Current.load();
+}
+
+SceneStore::Snapshot SceneStore::Acquire() const
+{
+	for (;;)
+	{
+		for (uint32_t slot = 0; slot < MaxReaders; slot++)
+		{
+			// The epoch is announced before the version is loaded. A version retired in an epoch
+			// before ours was swapped out before we loaded, so we can never see it.
+			uint64_t epoch = m_Epoch.load();
+			uint64_t expected = 0;
+			if (!m_ReaderEpochs[slot].compare_exchange_strong(expected, epoch))
+				continue;
+
+			const Version* version = m_Current.load();
+
+			Snapshot snapshot;
+			snapshot.m_Store = this;
+			snapshot.m_Scene = &version->Data;
+			snapshot.m_Version = version->Number;
+			snapshot.m_Slot = slot;
+
+			return snapshot;
+		}
+
+		std::this_thread::yield();
+	}
+}
+
+uint64_t SceneStore::Publish(Scene scene)
+{
+	std::lock_guard<std::mutex> lock(m_EditMutex);
+	return PublishLocked(std::move(scene));
+}
+
+uint64_t SceneStore::PublishLocked(Scene scene)
+{
+	uint64_t number = m_Current.load()->Number + 1;
+	Version* previous = m_Current.exchange(new Version{ std::move(scene), number });
+
+	// Readers that announced this epoch or an earlier one may still hold the previous version
+	uint64_t epoch = m_Epoch.fetch_add(1);
+	m_Retired.push_back({ std::unique_ptr<Version>(previous), epoch });
+
+	Reclaim();
+
+	return number;
+}
+
+void SceneStore::Reclaim()
+{
+	uint64_t oldestReader = UINT64_MAX;
+	for (const auto& readerEpoch : m_ReaderEpochs)
+	{
+		uint64_t epoch = readerEpoch.load();
+		if (epoch != 0)
+			oldestReader = std::min(oldestReader, epoch);
+	}
+
+	m_Retired.erase(std::remove_if(m_Retired.begin(), m_Retired.end(), [oldestReader](const RetiredVersion& retired)
+	{
+		return retired.Epoch < oldestReader;
+	}), m_Retired.end());
+}
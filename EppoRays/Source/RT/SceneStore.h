@@ -0,0 +1,102 @@
+#pragma once
+
+#include "RT/Scene.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Holds immutable versions of a scene. Readers pin the current version for as long as they need it,
+// editors publish a new version next to it with an atomic pointer swap. Old versions are freed once
+// no reader can still be using them, readers never take a lock.
+class SceneStore
+{
+public:
+	// Concurrent readers, acquiring spins when all slots are taken
+	static constexpr uint32_t MaxReaders = 64;
+
+	class Snapshot
+	{
+	public:
+		Snapshot() = default;
+		~Snapshot();
+
+		Snapshot(Snapshot&& other) noexcept;
+		Snapshot& operator=(Snapshot&& other) noexcept;
+
+		Snapshot(const Snapshot&) = delete;
+		Snapshot& operator=(const Snapshot&) = delete;
+
+		void Release();
+
+		const Scene& operator*() const { return *m_Scene; }
+		const Scene* operator->() const { return m_Scene; }
+		explicit operator bool() const { return m_Scene != nullptr; }
+
+		uint64_t GetVersion() const { return m_Version; }
+
+	private:
+		friend class SceneStore;
+
+		const SceneStore* m_Store = nullptr;
+		const Scene* m_Scene = nullptr;
+		uint64_t m_Version = 0;
+		uint32_t m_Slot = 0;
+	};
+
+public:
+	explicit SceneStore(Scene scene = Scene());
+	~SceneStore();
+
+	SceneStore(const SceneStore&) = delete;
+	SceneStore& operator=(const SceneStore&) = delete;
+
+	Snapshot Acquire() const;
+
+	// Returns the number of the new version
+	uint64_t Publish(Scene scene);
+
+	// Applies the edit to a copy of the current version and publishes it, edits never get lost
+	// between concurrent editors. The copy shares every array the edit leaves alone.
+	template<typename Fn>
+	uint64_t Edit(Fn&& edit)
+	{
+		std::lock_guard<std::mutex> lock(m_EditMutex);
+
+		Scene scene = m_Current.load()->Data;
+		edit(scene);
+
+		return PublishLocked(std::move(scene));
+	}
+
+	uint64_t GetVersion() const { return m_Current.load()->Number; }
+
+private:
+	struct Version
+	{
+		Scene Data;
+		uint64_t Number = 0;
+	};
+
+	struct RetiredVersion
+	{
+		std::unique_ptr<Version> Data;
+		uint64_t Epoch = 0;
+	};
+
+	uint64_t PublishLocked(Scene scene);
+	void Reclaim();
+
+private:
+	std::atomic<Version*> m_Current;
+
+	// Readers announce the epoch they started in, zero marks a free slot
+	mutable std::atomic<uint64_t> m_Epoch = 1;
+	mutable std::array<std::atomic<uint64_t>, MaxReaders> m_ReaderEpochs = {};
+
+	// Only editors touch these
+	std::mutex m_EditMutex;
+	std::vector<RetiredVersion> m_Retired;
+};
@@ -0,0 +1,114 @@
+#include "Sequence.h"
+
+#include <algorithm>
+
+SequenceRenderer::~SequenceRenderer()
+{
+	Cancel();
+}
+
+void SequenceRenderer::Begin(const Scene& scene, const Animation& animation, uint32_t firstFrame, uint32_t lastFrame)
+{
+	Cancel();
+
+	m_Animation = &animation;
+	m_FirstFrame = firstFrame;
+	m_LastFrame = lastFrame;
+	m_CurrentFrame = firstFrame;
+	m_CurrentBuffer = 0;
+
+	// Both buffers start from the same scene, after that they only receive deltas
+	for (auto& buffer : m_Buffers)
+		buffer.FrameScene = scene;
+
+	PrepareFrame(m_Buffers[0], firstFrame);
+	if (firstFrame < lastFrame)
+		PrepareNextFrameAsync(m_Buffers[1], firstFrame + 1);
+
+	m_Active = true;
+}
+
+void SequenceRenderer::Cancel()
+{
+	if (m_PrepareTask.valid())
+		m_PrepareTask.wait();
+
+	m_Active = false;
+}
+
+bool SequenceRenderer::RenderNextFrame(Renderer& renderer, const Camera& camera, Renderer::RenderMode mode)
+{
+	if (!m_Active)
+		return false;
+
+	FrameBuffer& buffer = m_Buffers[m_CurrentBuffer];
+
+	// Offline frames always cover the whole image and keep all their passes, the frame budget is for
+	// interactive use only.
+	// On the CPU all samples of a frame are taken in a single pass, so the frame is resolved once,
+	// unless path guiding needs a few passes to learn from.
+	auto& settings = renderer.GetSettings();
+	bool accumulate = settings.Accumulate;
+	bool useFrameBudget = settings.UseFrameBudget;
+	uint32_t samplesPerPass = settings.SamplesPerPass;
+	uint32_t displayInterval = settings.DisplayInterval;
+
+	uint32_t passes = 1;
+	if (mode == Renderer::RenderMode::Gpu)
+		passes = m_SamplesPerFrame;
+	else if (settings.UsePathGuiding)
+		passes = std::min(m_SamplesPerFrame, Renderer::GuidedPassCount);
+
+	settings.Accumulate = true;
+	settings.UseFrameBudget = false;
+	settings.DisplayInterval = 1;
+
+	renderer.ResetFrameIndex();
+	for (uint32_t i = 0; i < passes; i++)
+	{
+		// Spreads the remainder over the passes, the frame always gets exactly its samples
+		settings.SamplesPerPass = m_SamplesPerFrame * (i + 1) / passes - m_SamplesPerFrame * i / passes;
+		renderer.Render(buffer.FrameScene, camera, mode, false);
+	}
+
+	settings.Accumulate = accumulate;
+	settings.UseFrameBudget = useFrameBudget;
+	settings.SamplesPerPass = samplesPerPass;
+	settings.DisplayInterval = displayInterval;
+
+	if (m_CurrentFrame >= m_LastFrame)
+	{
+		Cancel();
+		return false;
+	}
+
+	// The next frame was prepared while we were tracing this one
+	if (m_PrepareTask.valid())
+		m_PrepareTask.wait();
+
+	m_CurrentFrame++;
+	m_CurrentBuffer ^= 1;
+
+	// The buffer we just traced is free again, start preparing the frame after the next one
+	if (m_CurrentFrame < m_LastFrame)
+		PrepareNextFrameAsync(buffer, m_CurrentFrame + 1);
+
+	return true;
+}
+
+void SequenceRenderer::PrepareFrame(FrameBuffer& buffer, uint32_t frame)
+{
+	buffer.Frame = frame;
+
+	// Deltas are relative to whatever frame this buffer held last, which is usually two frames back
+	m_Animation->Evaluate((float)frame, buffer.FrameScene, buffer.Deltas);
+	Animation::ApplyDeltas(buffer.FrameScene, buffer.Deltas);
+}
+
+void SequenceRenderer::PrepareNextFrameAsync(FrameBuffer& buffer, uint32_t frame)
+{
+	m_PrepareTask = m_ThreadPool->Submit([this, &buffer, frame]()
+	{
+		PrepareFrame(buffer, frame);
+	});
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "RT/Animation.h"
+#include "RT/Camera.h"
+#include "RT/Renderer.h"
+#include "RT/Scene.h"
+#include "RT/ThreadPool.h"
+
+#include <array>
+#include <future>
+#include <vector>
+
+class SequenceRenderer
+{
+public:
+	SequenceRenderer() = default;
+
+	// Frames are prepared on the pool, usually the one the renderer traces on
+	explicit SequenceRenderer(std::shared_ptr<ThreadPool> threadPool)
+		: m_ThreadPool(std::move(threadPool))
+	{}
+
+	~SequenceRenderer();
+
+	// Scene is copied, edits made to it afterwards don't affect the running sequence
+	void Begin(const Scene& scene, const Animation& animation, uint32_t firstFrame, uint32_t lastFrame);
+	void Cancel();
+
+	// Renders one frame and returns false once the sequence is finished
+	bool RenderNextFrame(Renderer& renderer, const Camera& camera, Renderer::RenderMode mode);
+
+	bool IsActive() const { return m_Active; }
+	uint32_t GetCurrentFrame() const { return m_CurrentFrame; }
+	uint32_t GetFirstFrame() const { return m_FirstFrame; }
+	uint32_t GetLastFrame() const { return m_LastFrame; }
+
+	void SetSamplesPerFrame(uint32_t samples) { m_SamplesPerFrame = samples; }
+	uint32_t GetSamplesPerFrame() const { return m_SamplesPerFrame; }
+
+private:
+	struct FrameBuffer
+	{
+		Scene FrameScene;
+		std::vector<SphereDelta> Deltas;
+		uint32_t Frame = 0;
+	};
+
+	void PrepareFrame(FrameBuffer& buffer, uint32_t frame);
+	void PrepareNextFrameAsync(FrameBuffer& buffer, uint32_t frame);
+
+private:
+	// Frame N is traced from one buffer while frame N+1 is prepared in the other
+	std::array<FrameBuffer, 2> m_Buffers;
+	uint32_t m_CurrentBuffer = 0;
+	std::future<void> m_PrepareTask;
+	std::shared_ptr<ThreadPool> m_ThreadPool = std::make_shared<ThreadPool>(1);
+
+	const Animation* m_Animation = nullptr;
+
+	bool m_Active = false;
+	uint32_t m_FirstFrame = 0;
+	uint32_t m_LastFrame = 0;
+	uint32_t m_CurrentFrame = 0;
+	uint32_t m_SamplesPerFrame = 16;
+};
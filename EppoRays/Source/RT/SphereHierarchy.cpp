@@ -0,0 +1,154 @@
+#include "SphereHierarchy.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <numeric>
+
+namespace Utils
+{
+	constexpr uint32_t MaxLeafSize = 4;
+
+	inline static uint32_t GetLargestAxis(const glm::vec3& extent)
+	{
+		if (extent.x > extent.y && extent.x > extent.z)
+			return 0;
+
+		return extent.y > extent.z ? 1 : 2;
+	}
+}
+
+void SphereHierarchy::Build(const Scene& scene)
+{
+	uint32_t count = (uint32_t)scene.m_Spheres->size();
+
+	m_Nodes.clear();
+	m_SphereIndices.resize(count);
+	std::iota(m_SphereIndices.begin(), m_SphereIndices.end(), 0);
+
+	if (count == 0)
+		return;
+
+	// A binary tree with at least one sphere per leaf never needs more nodes than this,
+	// reserving up front keeps node references valid while building
+	m_Nodes.reserve(2 * count);
+	m_Nodes.emplace_back();
+	BuildNode(scene, 0, 0, count);
+
+	Refit(scene);
+}
+
+void SphereHierarchy::Refit(const Scene& scene)
+{
+	m_ProxyMaterials.resize(m_Nodes.size());
+	m_NodeArea.resize(m_Nodes.size());
+
+	// Children are always stored after their parent, so walking backwards visits them first
+	for (size_t i = m_Nodes.size(); i > 0; i--)
+		RefitNode(scene, (uint32_t)i - 1);
+}
+
+void SphereHierarchy::BuildNode(const Scene& scene, uint32_t nodeIndex, uint32_t first, uint32_t count)
+{
+	if (count <= Utils::MaxLeafSize)
+	{
+		m_Nodes[nodeIndex].First = first;
+		m_Nodes[nodeIndex].Count = count;
+		return;
+	}
+
+	// Median split along the largest axis of the sphere centers
+	const auto& spheres = *scene.m_Spheres;
+
+	glm::vec3 centerMin(FLT_MAX);
+	glm::vec3 centerMax(-FLT_MAX);
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		const glm::vec3& position = spheres[m_SphereIndices[i]].Position;
+		centerMin = glm::min(centerMin, position);
+		centerMax = glm::max(centerMax, position);
+	}
+
+	uint32_t axis = Utils::GetLargestAxis(centerMax - centerMin);
+	uint32_t middle = first + count / 2;
+
+	auto begin = m_SphereIndices.begin();
+	std::nth_element(begin + first, begin + middle, begin + first + count, [&spheres, axis](uint32_t a, uint32_t b)
+	{
+		return spheres[a].Position[axis] < spheres[b].Position[axis];
+	});
+
+	uint32_t left = (uint32_t)m_Nodes.size();
+	m_Nodes.emplace_back();
+	m_Nodes.emplace_back();
+
+	m_Nodes[nodeIndex].First = left;
+	m_Nodes[nodeIndex].Count = 0;
+
+	BuildNode(scene, left, first, middle - first);
+	BuildNode(scene, left + 1, middle, first + count - middle);
+}
+
+void SphereHierarchy::RefitNode(const Scene& scene, uint32_t nodeIndex)
+{
+	Node& node = m_Nodes[nodeIndex];
+
+	glm::vec3 boundsMin(FLT_MAX);
+	glm::vec3 boundsMax(-FLT_MAX);
+
+	// Proxies are weighted by surface area, that is what rays actually see
+	float area = 0.0f;
+	glm::vec3 position(0.0f);
+	glm::vec3 albedo(0.0f);
+	glm::vec3 emission(0.0f);
+	float roughness = 0.0f;
+
+	auto accumulate = [&](const glm::vec3& childPosition, float childArea, const Material& material)
+	{
+		area += childArea;
+		position += childPosition * childArea;
+		albedo += material.Albedo * childArea;
+		emission += material.Emission * material.EmissionPower * childArea;
+		roughness += material.Roughness * childArea;
+	};
+
+	if (node.IsLeaf())
+	{
+		for (uint32_t i = node.First; i < node.First + node.Count; i++)
+		{
+			const Sphere& sphere = (*scene.m_Spheres)[m_SphereIndices[i]];
+
+			boundsMin = glm::min(boundsMin, sphere.Position - glm::vec3(sphere.Radius));
+			boundsMax = glm::max(boundsMax, sphere.Position + glm::vec3(sphere.Radius));
+
+			accumulate(sphere.Position, sphere.Radius * sphere.Radius, (*scene.m_Materials)[sphere.MaterialIndex]);
+		}
+	} else
+	{
+		for (uint32_t child = node.First; child < node.First + 2; child++)
+		{
+			const Node& childNode = m_Nodes[child];
+
+			boundsMin = glm::min(boundsMin, childNode.BoundsMin);
+			boundsMax = glm::max(boundsMax, childNode.BoundsMax);
+
+			accumulate(childNode.ProxyPosition, m_NodeArea[child], m_ProxyMaterials[child]);
+		}
+	}
+
+	node.BoundsMin = boundsMin;
+	node.BoundsMax = boundsMax;
+	m_NodeArea[nodeIndex] = area;
+
+	float weight = area > 0.0f ? 1.0f / area : 0.0f;
+	node.ProxyPosition = area > 0.0f ? position * weight : 0.5f * (boundsMin + boundsMax);
+
+	// Keep the total surface area, but never grow beyond what the children actually cover
+	glm::vec3 farthestCorner = glm::max(glm::abs(boundsMax - node.ProxyPosition), glm::abs(node.ProxyPosition - boundsMin));
+	node.ProxyRadius = std::min(glm::sqrt(area), glm::length(farthestCorner));
+
+	Material& material = m_ProxyMaterials[nodeIndex];
+	material.Albedo = albedo * weight;
+	material.Roughness = roughness * weight;
+	material.Emission = emission * weight;
+	material.EmissionPower = 1.0f;
+}
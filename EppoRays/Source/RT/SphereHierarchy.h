@@ -0,0 +1,55 @@
+#pragma once
+
+#include "RT/Scene.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Bounding volume hierarchy over the scene spheres. Every node also carries a proxy sphere with the
+// averaged material of everything below it, which is used instead of the node's contents when the
+// node is smaller than the footprint of the ray that hits it.
+class SphereHierarchy
+{
+public:
+	struct Node
+	{
+		glm::vec3 BoundsMin = glm::vec3(0.0f);
+		uint32_t First = 0; // First child for internal nodes, first sphere index for leaves
+		glm::vec3 BoundsMax = glm::vec3(0.0f);
+		uint32_t Count = 0; // Number of spheres for leaves, 0 for internal nodes
+
+		glm::vec3 ProxyPosition = glm::vec3(0.0f);
+		float ProxyRadius = 0.0f;
+
+		bool IsLeaf() const { return Count > 0; }
+	};
+
+public:
+	SphereHierarchy() = default;
+
+	void Build(const Scene& scene);
+
+	// Updates bounds, proxies and proxy materials without changing the tree layout,
+	// which is all that is needed when spheres move or materials change
+	void Refit(const Scene& scene);
+
+	bool IsEmpty() const { return m_Nodes.empty(); }
+	size_t GetSphereCount() const { return m_SphereIndices.size(); }
+
+	const std::vector<Node>& GetNodes() const { return m_Nodes; }
+	const std::vector<uint32_t>& GetSphereIndices() const { return m_SphereIndices; }
+	const std::vector<Material>& GetProxyMaterials() const { return m_ProxyMaterials; }
+
+private:
+	void BuildNode(const Scene& scene, uint32_t nodeIndex, uint32_t first, uint32_t count);
+	void RefitNode(const Scene& scene, uint32_t nodeIndex);
+
+private:
+	std::vector<Node> m_Nodes;
+	std::vector<uint32_t> m_SphereIndices;
+
+	// One per node, proxies are shaded with these
+	std::vector<Material> m_ProxyMaterials;
+	std::vector<float> m_NodeArea;
+};
@@ -0,0 +1,109 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	m_Threads.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; i++)
+		m_Threads.emplace_back([this]() { WorkerLoop(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stopping = true;
+	}
+
+	m_Condition.notify_all();
+
+	for (auto& thread : m_Threads)
+		thread.join();
+}
+
+std::future<void> ThreadPool::Submit(std::function<void()> task)
+{
+	std::packaged_task<void()> packagedTask(std::move(task));
+	std::future<void> future = packagedTask.get_future();
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Tasks.push(std::move(packagedTask));
+	}
+
+	m_Condition.notify_one();
+
+	return future;
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& fn)
+{
+	if (count == 0)
+		return;
+
+	// Helpers might only get picked up after we are done, so they must not reference our stack
+	struct State
+	{
+		std::function<void(uint32_t)> Fn;
+		uint32_t Count = 0;
+		std::atomic<uint32_t> Next = 0;
+		std::atomic<uint32_t> Done = 0;
+
+		std::mutex Mutex;
+		std::condition_variable Condition;
+	};
+
+	auto state = std::make_shared<State>();
+	state->Fn = fn;
+	state->Count = count;
+
+	auto work = [state]()
+	{
+		uint32_t index;
+		while ((index = state->Next.fetch_add(1)) < state->Count)
+		{
+			state->Fn(index);
+
+			if (state->Done.fetch_add(1) + 1 == state->Count)
+			{
+				std::lock_guard<std::mutex> lock(state->Mutex);
+				state->Condition.notify_all();
+			}
+		}
+	};
+
+	uint32_t helpers = std::min(count - 1, GetThreadCount());
+	for (uint32_t i = 0; i < helpers; i++)
+		Submit(work);
+
+	work();
+
+	std::unique_lock<std::mutex> lock(state->Mutex);
+	state->Condition.wait(lock, [&state]() { return state->Done.load() == state->Count; });
+}
+
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::packaged_task<void()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Condition.wait(lock, [this]() { return m_Stopping || !m_Tasks.empty(); });
+
+			if (m_Stopping && m_Tasks.empty())
+				return;
+
+			task = std::move(m_Tasks.front());
+			m_Tasks.pop();
+		}
+
+		task();
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	// A thread count of 0 uses all hardware threads
+	explicit ThreadPool(uint32_t threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	std::future<void> Submit(std::function<void()> task);
+
+	// Runs fn for every index in [0, count) and blocks until all are done. The calling thread helps out,
+	// so this is safe to use from within a task running on the same pool.
+	void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& fn);
+
+	uint32_t GetThreadCount() const { return (uint32_t)m_Threads.size(); }
+
+private:
+	void WorkerLoop();
+
+private:
+	std::vector<std::thread> m_Threads;
+	std::queue<std::packaged_task<void()>> m_Tasks;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	bool m_Stopping = false;
+};
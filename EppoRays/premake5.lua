@@ -19,7 +19,8 @@ project "EppoRays"
 
         "%{IncludeDir.glm}",
         "%{IncludeDir.imgui}",
-        "%{IncludeDir.spdlog}"
+        "%{IncludeDir.spdlog}",
+        "%{IncludeDir.stb}"
     }
 
     links {
@@ -0,0 +1,193 @@
+#include "RenderClient.h"
+#include "RenderServer.h"
+
+#include "RT/SceneSerializer.h"
+
+#include <EppoCore.h>
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace Utils
+{
+	static RenderServer* s_Server = nullptr;
+
+	inline static void OnSignal(int)
+	{
+		if (s_Server)
+			s_Server->Stop();
+	}
+
+	inline static void PrintUsage()
+	{
+		printf("Usage:\n");
+		printf("  EppoRaysServer serve [--socket <path>] [--cache <scenes>] [--threads <count>]\n");
+		printf("  EppoRaysServer submit <scene file> [--socket <path>] [--repeat <count>] [--wait] [key=value ...]\n");
+		printf("  EppoRaysServer status|wait|cancel <job> [--socket <path>]\n");
+		printf("  EppoRaysServer ping|stats|shutdown [--socket <path>]\n");
+		printf("\nRender options: width height samples bounces priority fov position=x,y,z direction=x,y,z output format\n");
+	}
+
+	inline static bool Connect(RenderClient& client, const std::string& socketPath)
+	{
+		if (client.Connect(socketPath))
+			return true;
+
+		fprintf(stderr, "Could not connect to '%s', is the server running?\n", socketPath.c_str());
+		return false;
+	}
+}
+
+static int Serve(const ServerSpecification& specification)
+{
+	RenderServer server(specification);
+
+	Utils::s_Server = &server;
+	std::signal(SIGINT, Utils::OnSignal);
+	std::signal(SIGTERM, Utils::OnSignal);
+
+	bool result = server.Run();
+	Utils::s_Server = nullptr;
+
+	return result ? 0 : 1;
+}
+
+static int Submit(const std::string& socketPath, const std::string& sceneFile, const std::string& options, uint32_t repeat, bool wait)
+{
+	Scene scene;
+	std::string error;
+	if (!SceneSerializer::LoadFromFile(sceneFile, scene, error))
+	{
+		fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+
+	RenderClient client;
+	if (!Utils::Connect(client, socketPath))
+		return 1;
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::string hash;
+	if (!client.UploadScene(scene, hash, error))
+	{
+		fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+
+	std::vector<std::string> jobs;
+	for (uint32_t i = 0; i < repeat; i++)
+	{
+		std::string reply;
+		if (!client.Request("render " + hash + options, reply) || reply.rfind("ok ", 0) != 0)
+		{
+			fprintf(stderr, "%s\n", reply.empty() ? "Connection lost" : reply.c_str());
+			return 1;
+		}
+
+		jobs.push_back(reply.substr(3));
+		printf("%s\n", jobs.back().c_str());
+	}
+
+	if (!wait)
+		return 0;
+
+	int result = 0;
+	for (const auto& job : jobs)
+	{
+		std::string reply;
+		if (!client.Request("wait " + job, reply))
+			return 1;
+
+		if (reply != "ok done")
+		{
+			fprintf(stderr, "Job %s: %s\n", job.c_str(), reply.c_str());
+			result = 1;
+		}
+	}
+
+	float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	printf("%u jobs in %.1fms, %.2fms per job\n", repeat, milliseconds, milliseconds / (float)repeat);
+
+	return result;
+}
+
+static int SendCommand(const std::string& socketPath, const std::string& request)
+{
+	RenderClient client;
+	if (!Utils::Connect(client, socketPath))
+		return 1;
+
+	std::string reply;
+	if (!client.Request(request, reply))
+	{
+		fprintf(stderr, "Connection lost\n");
+		return 1;
+	}
+
+	printf("%s\n", reply.c_str());
+	return reply.rfind("ok", 0) == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+	Eppo::Log::Init();
+
+	if (argc < 2)
+	{
+		Utils::PrintUsage();
+		return 1;
+	}
+
+	std::string command = argv[1];
+
+	ServerSpecification specification;
+	specification.SocketPath = (std::filesystem::temp_directory_path() / "EppoRays.sock").string();
+
+	std::vector<std::string> positional;
+	std::string options;
+	uint32_t repeat = 1;
+	bool wait = false;
+
+	for (int i = 2; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (argument == "--socket" && hasValue)
+			specification.SocketPath = argv[++i];
+		else if (argument == "--cache" && hasValue)
+			specification.CacheCapacity = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		else if (argument == "--threads" && hasValue)
+			specification.ThreadCount = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		else if (argument == "--repeat" && hasValue)
+			repeat = std::max((uint32_t)strtoul(argv[++i], nullptr, 10), 1u);
+		else if (argument == "--wait")
+			wait = true;
+		else if (argument.find('=') != std::string::npos)
+			options += ' ' + argument;
+		else
+			positional.push_back(argument);
+	}
+
+	if (command == "serve")
+		return Serve(specification);
+
+	if (command == "submit" && positional.size() == 1)
+		return Submit(specification.SocketPath, positional[0], options, repeat, wait);
+
+	if ((command == "status" || command == "wait" || command == "cancel") && positional.size() == 1)
+		return SendCommand(specification.SocketPath, command + ' ' + positional[0]);
+
+	if ((command == "ping" || command == "stats" || command == "shutdown") && positional.empty())
+		return SendCommand(specification.SocketPath, command);
+
+	Utils::PrintUsage();
+	return 1;
+}
@@ -0,0 +1,201 @@
+#include "JobQueue.h"
+
+#include <algorithm>
+
+namespace Utils
+{
+	constexpr size_t MaxFinishedJobs = 4096;
+
+	// std::push_heap keeps the largest element on top
+	inline static bool RunsAfter(const std::shared_ptr<RenderJob>& a, const std::shared_ptr<RenderJob>& b)
+	{
+		if (a->Priority != b->Priority)
+			return a->Priority < b->Priority;
+
+		return a->Id > b->Id;
+	}
+}
+
+const char* JobStateToString(JobState state)
+{
+	switch (state)
+	{
+		case JobState::Queued:		return "queued";
+		case JobState::Running:		return "running";
+		case JobState::Writing:		return "writing";
+		case JobState::Done:		return "done";
+		case JobState::Failed:		return "failed";
+		case JobState::Cancelled:	return "cancelled";
+	}
+
+	return "unknown";
+}
+
+uint64_t JobQueue::Submit(std::shared_ptr<RenderJob> job)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	job->Id = m_NextId++;
+	job->State = JobState::Queued;
+
+	m_Jobs[job->Id] = job;
+	m_Queue.push_back(job);
+	std::push_heap(m_Queue.begin(), m_Queue.end(), Utils::RunsAfter);
+	m_QueuedCount++;
+
+	m_JobAvailable.notify_one();
+
+	return job->Id;
+}
+
+std::shared_ptr<RenderJob> JobQueue::WaitForNext()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+
+	for (;;)
+	{
+		m_JobAvailable.wait(lock, [this]() { return m_Stopped || !m_Queue.empty(); });
+		if (m_Stopped)
+			return nullptr;
+
+		std::pop_heap(m_Queue.begin(), m_Queue.end(), Utils::RunsAfter);
+		std::shared_ptr<RenderJob> job = std::move(m_Queue.back());
+		m_Queue.pop_back();
+
+		if (job->State != JobState::Queued)
+			continue;
+
+		m_QueuedCount--;
+		job->State = JobState::Running;
+		m_JobChanged.notify_all();
+
+		return job;
+	}
+}
+
+bool JobQueue::Cancel(uint64_t id)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	auto it = m_Jobs.find(id);
+	if (it == m_Jobs.end())
+		return false;
+
+	RenderJob& job = *it->second;
+	if (job.State == JobState::Queued)
+	{
+		m_QueuedCount--;
+		job.State = JobState::Cancelled;
+		Retire(id);
+
+		m_JobChanged.notify_all();
+	} else if (job.State == JobState::Running)
+	{
+		job.CancelRequested = true;
+	}
+
+	return true;
+}
+
+void JobQueue::CancelAll()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	// Retiring can drop old jobs from the map, so that happens after walking it
+	std::vector<uint64_t> cancelled;
+	for (auto& [id, job] : m_Jobs)
+	{
+		if (job->State == JobState::Queued)
+		{
+			job->State = JobState::Cancelled;
+			cancelled.push_back(id);
+		} else if (job->State == JobState::Running)
+		{
+			job->CancelRequested = true;
+		}
+	}
+
+	for (uint64_t id : cancelled)
+		Retire(id);
+
+	m_Queue.clear();
+	m_QueuedCount = 0;
+
+	m_JobChanged.notify_all();
+}
+
+std::shared_ptr<RenderJob> JobQueue::Find(uint64_t id)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	auto it = m_Jobs.find(id);
+	return it != m_Jobs.end() ? it->second : nullptr;
+}
+
+JobState JobQueue::GetState(RenderJob& job)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	// Writing finishes on the image writer's threads, pick up the result lazily
+	if (job.State == JobState::Writing && job.Output.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		job.State = job.Output.get() ? JobState::Done : JobState::Failed;
+
+	return job.State;
+}
+
+void JobQueue::SetState(RenderJob& job, JobState state)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	// A job is retired once, moving on from Writing doesn't count as finishing again
+	bool wasFinished = IsFinished(job.State);
+	job.State = state;
+	if (IsFinished(state) && !wasFinished)
+		Retire(job.Id);
+
+	m_JobChanged.notify_all();
+}
+
+JobState JobQueue::WaitForCompletion(RenderJob& job)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_JobChanged.wait(lock, [this, &job]() { return m_Stopped || IsFinished(job.State); });
+	}
+
+	if (GetState(job) == JobState::Writing)
+		job.Output.wait();
+
+	return GetState(job);
+}
+
+uint32_t JobQueue::GetQueuedCount()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_QueuedCount;
+}
+
+void JobQueue::Stop()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	m_Stopped = true;
+	m_JobAvailable.notify_all();
+	m_JobChanged.notify_all();
+}
+
+bool JobQueue::IsFinished(JobState state)
+{
+	return state != JobState::Queued && state != JobState::Running;
+}
+
+void JobQueue::Retire(uint64_t id)
+{
+	m_Finished.push_back(id);
+
+	while (m_Finished.size() > Utils::MaxFinishedJobs)
+	{
+		m_Jobs.erase(m_Finished.front());
+		m_Finished.pop_front();
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "SceneCache.h"
+
+#include "RT/ImageWriter.h"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class JobState
+{
+	Queued,
+	Running,
+	Writing,
+	Done,
+	Failed,
+	Cancelled
+};
+
+const char* JobStateToString(JobState state);
+
+struct RenderJob
+{
+	uint64_t Id = 0;
+	int32_t Priority = 0;
+	std::shared_ptr<CachedScene> JobScene;
+
+	glm::vec3 CameraPosition = glm::vec3(0.0f, 1.0f, 7.0f);
+	glm::vec3 CameraDirection = glm::vec3(0.0f, 0.0f, -1.0f);
+	float FieldOfView = 45.0f;
+
+	uint32_t Width = 512;
+	uint32_t Height = 512;
+	uint32_t Samples = 64;
+	uint32_t Bounces = 5;
+
+	std::string OutputPath;
+	ImageFormat Format = ImageFormat::PNG;
+
+	std::atomic<bool> CancelRequested = false;
+	std::atomic<uint32_t> SamplesDone = 0;
+
+	// Owned by the queue, use JobQueue::GetState
+	JobState State = JobState::Queued;
+	std::shared_future<bool> Output;
+};
+
+// Jobs with a higher priority run first, equal priorities run in submission order
+class JobQueue
+{
+public:
+	JobQueue() = default;
+
+	uint64_t Submit(std::shared_ptr<RenderJob> job);
+
+	// Blocks until a job is available, returns null once the queue is stopped
+	std::shared_ptr<RenderJob> WaitForNext();
+
+	// Queued jobs are dropped right away, running jobs stop after their current pass
+	bool Cancel(uint64_t id);
+	void CancelAll();
+
+	std::shared_ptr<RenderJob> Find(uint64_t id);
+	JobState GetState(RenderJob& job);
+	void SetState(RenderJob& job, JobState state);
+
+	// Blocks until the job is done, failed or cancelled
+	JobState WaitForCompletion(RenderJob& job);
+
+	uint32_t GetQueuedCount();
+
+	void Stop();
+
+private:
+	static bool IsFinished(JobState state);
+	void Retire(uint64_t id);
+
+private:
+	std::mutex m_Mutex;
+	std::condition_variable m_JobAvailable;
+	std::condition_variable m_JobChanged;
+	bool m_Stopped = false;
+
+	// Binary heap on priority, cancelled jobs are skipped when they come up
+	std::vector<std::shared_ptr<RenderJob>> m_Queue;
+	uint32_t m_QueuedCount = 0;
+
+	// Finished jobs stay around for a while so clients can still ask for their state
+	std::unordered_map<uint64_t, std::shared_ptr<RenderJob>> m_Jobs;
+	std::deque<uint64_t> m_Finished;
+	uint64_t m_NextId = 1;
+};
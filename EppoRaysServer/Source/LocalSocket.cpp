@@ -0,0 +1,251 @@
+#include "LocalSocket.h"
+
+#include <EppoCore.h>
+
+#include <cstring>
+
+#ifdef EPPO_WINDOWS
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <WinSock2.h>
+	#include <afunix.h>
+
+	#pragma comment(lib, "Ws2_32.lib")
+#else
+	#include <sys/socket.h>
+	#include <sys/un.h>
+	#include <unistd.h>
+#endif
+
+namespace Utils
+{
+#ifdef EPPO_WINDOWS
+	// Winsock has to be started once per process before any socket call
+	inline static void InitSockets()
+	{
+		static bool initialized = []()
+		{
+			WSADATA data;
+			return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+		}();
+		(void)initialized;
+	}
+
+	using NativeHandle = SOCKET;
+
+	inline static void CloseSocket(NativeHandle handle) { closesocket(handle); }
+	inline static void RemovePath(const std::string& path) { DeleteFileA(path.c_str()); }
+	constexpr int ShutdownBoth = SD_BOTH;
+	constexpr int SendFlags = 0;
+#else
+	inline static void InitSockets() {}
+	using NativeHandle = int;
+
+	inline static void CloseSocket(NativeHandle handle) { close(handle); }
+	inline static void RemovePath(const std::string& path) { unlink(path.c_str()); }
+	constexpr int ShutdownBoth = SHUT_RDWR;
+
+	// A client that went away must not kill the server with SIGPIPE
+	constexpr int SendFlags = MSG_NOSIGNAL;
+#endif
+
+	inline static bool MakeAddress(const std::string& path, sockaddr_un& address)
+	{
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+
+		if (path.size() >= sizeof(address.sun_path))
+			return false;
+
+		memcpy(address.sun_path, path.c_str(), path.size());
+		return true;
+	}
+}
+
+LocalSocket::~LocalSocket()
+{
+	Close();
+}
+
+LocalSocket::LocalSocket(LocalSocket&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+LocalSocket& LocalSocket::operator=(LocalSocket&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+
+		m_Handle = other.m_Handle;
+		m_Path = std::move(other.m_Path);
+		m_Buffer = std::move(other.m_Buffer);
+		m_BufferOffset = other.m_BufferOffset;
+
+		other.m_Handle = InvalidHandle;
+		other.m_Path.clear();
+	}
+
+	return *this;
+}
+
+bool LocalSocket::Listen(const std::string& path)
+{
+	Utils::InitSockets();
+
+	sockaddr_un address;
+	if (!Utils::MakeAddress(path, address))
+		return false;
+
+	m_Handle = (intptr_t)socket(AF_UNIX, SOCK_STREAM, 0);
+	if (!IsValid())
+		return false;
+
+	// A server that crashed leaves its socket file behind, a running one still accepts connections
+	LocalSocket probe;
+	if (probe.Connect(path))
+	{
+		Close();
+		return false;
+	}
+
+	Utils::RemovePath(path);
+
+	if (bind((Utils::NativeHandle)m_Handle, (sockaddr*)&address, sizeof(address)) != 0 || listen((Utils::NativeHandle)m_Handle, 64) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_Path = path;
+	return true;
+}
+
+LocalSocket LocalSocket::Accept()
+{
+	LocalSocket client;
+	client.m_Handle = (intptr_t)accept((Utils::NativeHandle)m_Handle, nullptr, nullptr);
+
+	return client;
+}
+
+bool LocalSocket::Connect(const std::string& path)
+{
+	Utils::InitSockets();
+
+	sockaddr_un address;
+	if (!Utils::MakeAddress(path, address))
+		return false;
+
+	m_Handle = (intptr_t)socket(AF_UNIX, SOCK_STREAM, 0);
+	if (!IsValid())
+		return false;
+
+	if (connect((Utils::NativeHandle)m_Handle, (sockaddr*)&address, sizeof(address)) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void LocalSocket::Shutdown()
+{
+	if (IsValid())
+		shutdown((Utils::NativeHandle)m_Handle, Utils::ShutdownBoth);
+}
+
+void LocalSocket::Close()
+{
+	if (!IsValid())
+		return;
+
+	Utils::CloseSocket((Utils::NativeHandle)m_Handle);
+	m_Handle = InvalidHandle;
+
+	// Only the listening socket owns the path
+	if (!m_Path.empty())
+	{
+		Utils::RemovePath(m_Path);
+		m_Path.clear();
+	}
+}
+
+bool LocalSocket::Send(const std::string& data)
+{
+	size_t sent = 0;
+	while (sent < data.size())
+	{
+		auto result = send((Utils::NativeHandle)m_Handle, data.data() + sent, (int)(data.size() - sent), Utils::SendFlags);
+		if (result <= 0)
+			return false;
+
+		sent += (size_t)result;
+	}
+
+	return true;
+}
+
+bool LocalSocket::ReadLine(std::string& line)
+{
+	for (;;)
+	{
+		size_t end = m_Buffer.find('\n', m_BufferOffset);
+		if (end != std::string::npos)
+		{
+			line.assign(m_Buffer, m_BufferOffset, end - m_BufferOffset);
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+
+			m_BufferOffset = end + 1;
+			return true;
+		}
+
+		// Shutting down rather than closing, the owner may be waking this socket up from another thread
+		if (m_Buffer.size() - m_BufferOffset > MaxLineLength)
+		{
+			Shutdown();
+			m_Buffer.clear();
+			m_BufferOffset = 0;
+
+			return false;
+		}
+
+		if (!Fill())
+			return false;
+	}
+}
+
+bool LocalSocket::ReadBytes(size_t size, std::string& data)
+{
+	while (m_Buffer.size() - m_BufferOffset < size)
+	{
+		if (!Fill())
+			return false;
+	}
+
+	data.assign(m_Buffer, m_BufferOffset, size);
+	m_BufferOffset += size;
+
+	return true;
+}
+
+bool LocalSocket::Fill()
+{
+	// Drop what was consumed before growing the buffer
+	if (m_BufferOffset > 0)
+	{
+		m_Buffer.erase(0, m_BufferOffset);
+		m_BufferOffset = 0;
+	}
+
+	char chunk[4096];
+	auto result = recv((Utils::NativeHandle)m_Handle, chunk, (int)sizeof(chunk), 0);
+	if (result <= 0)
+		return false;
+
+	m_Buffer.append(chunk, (size_t)result);
+	return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Stream socket on a local path (AF_UNIX). Windows supports these too since Windows 10 1803.
+class LocalSocket
+{
+public:
+	// Commands and replies are short, a peer that sends more without a newline is cut off
+	static constexpr size_t MaxLineLength = 64 * 1024;
+
+public:
+	LocalSocket() = default;
+	~LocalSocket();
+
+	LocalSocket(LocalSocket&& other) noexcept;
+	LocalSocket& operator=(LocalSocket&& other) noexcept;
+
+	LocalSocket(const LocalSocket&) = delete;
+	LocalSocket& operator=(const LocalSocket&) = delete;
+
+	// Fails when another process is still listening on the path
+	bool Listen(const std::string& path);
+	LocalSocket Accept();
+	bool Connect(const std::string& path);
+
+	// Wakes up a thread blocked in Accept or a read on this socket
+	void Shutdown();
+	void Close();
+
+	bool IsValid() const { return m_Handle != InvalidHandle; }
+
+	bool Send(const std::string& data);
+
+	// Lines end with '\n', which is not part of the result. Fails and shuts the socket down when
+	// the line grows past MaxLineLength.
+	bool ReadLine(std::string& line);
+	bool ReadBytes(size_t size, std::string& data);
+
+private:
+	bool Fill();
+
+private:
+	// Wide enough for a SOCKET, INVALID_SOCKET also ends up as -1
+	static constexpr intptr_t InvalidHandle = -1;
+
+	intptr_t m_Handle = InvalidHandle;
+	std::string m_Path;
+
+	std::string m_Buffer;
+	size_t m_BufferOffset = 0;
+};
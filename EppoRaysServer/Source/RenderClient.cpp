@@ -0,0 +1,48 @@
+#include "RenderClient.h"
+
+#include "RT/SceneSerializer.h"
+
+bool RenderClient::Connect(const std::string& socketPath)
+{
+	return m_Socket.Connect(socketPath);
+}
+
+bool RenderClient::Request(const std::string& request, std::string& reply)
+{
+	return m_Socket.Send(request + '\n') && m_Socket.ReadLine(reply);
+}
+
+bool RenderClient::UploadScene(const Scene& scene, std::string& hash, std::string& error)
+{
+	// The server hashes the same canonical text, so we can ask for the scene before sending it
+	std::string text = SceneSerializer::Serialize(scene);
+
+	char buffer[17];
+	snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)SceneSerializer::Hash(text));
+	hash = buffer;
+
+	std::string reply;
+	if (!Request("has " + hash, reply))
+	{
+		error = "Connection lost";
+		return false;
+	}
+
+	if (reply == "ok")
+		return true;
+
+	if (!m_Socket.Send("scene " + std::to_string(text.size()) + '\n' + text) || !m_Socket.ReadLine(reply))
+	{
+		error = "Connection lost";
+		return false;
+	}
+
+	if (reply.rfind("ok ", 0) != 0)
+	{
+		error = reply;
+		return false;
+	}
+
+	hash = reply.substr(3);
+	return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "LocalSocket.h"
+
+#include "RT/Scene.h"
+
+#include <string>
+
+// Client side of the RenderServer protocol, requests are sent one at a time over a single connection
+class RenderClient
+{
+public:
+	RenderClient() = default;
+
+	bool Connect(const std::string& socketPath);
+
+	// Sends one request line and reads its reply line
+	bool Request(const std::string& request, std::string& reply);
+
+	// Uploads the scene unless the server knows it already, the hash identifies it in render requests
+	bool UploadScene(const Scene& scene, std::string& hash, std::string& error);
+
+private:
+	LocalSocket m_Socket;
+};
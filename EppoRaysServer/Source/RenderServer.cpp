@@ -0,0 +1,388 @@
+#include "RenderServer.h"
+
+#include "RT/Camera.h"
+#include "RT/RenderTarget.h"
+
+#include <EppoCore.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace Utils
+{
+	// Anything larger is almost certainly not a scene
+	constexpr size_t MaxSceneSize = 256 * 1024 * 1024;
+	constexpr uint32_t MaxImageSize = 16384;
+
+	// A render target takes 24 bytes per pixel, this keeps a single job under about 1.5 GB
+	constexpr uint64_t MaxPixelCount = 8192 * 8192;
+
+	// Several samples per pass keep the per pass overhead down, cancelling waits for the pass to end
+	constexpr uint32_t MaxSamplesPerPass = 16;
+
+	inline static std::string FormatHash(uint64_t hash)
+	{
+		char buffer[17];
+		snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)hash);
+		return buffer;
+	}
+
+	inline static bool ParseHash(const std::string& text, uint64_t& hash)
+	{
+		char* end = nullptr;
+		hash = strtoull(text.c_str(), &end, 16);
+		return !text.empty() && *end == '\0';
+	}
+
+	inline static bool ParseUInt(const std::string& text, uint64_t& value)
+	{
+		char* end = nullptr;
+		value = strtoull(text.c_str(), &end, 10);
+		return !text.empty() && text[0] != '-' && *end == '\0';
+	}
+
+	inline static bool ParseUInt(const std::string& text, uint32_t& value, uint32_t min, uint32_t max)
+	{
+		uint64_t result;
+		if (!ParseUInt(text, result) || result < min || result > max)
+			return false;
+
+		value = (uint32_t)result;
+		return true;
+	}
+
+	inline static bool ParseInt(const std::string& text, int32_t& value)
+	{
+		char* end = nullptr;
+		value = (int32_t)strtol(text.c_str(), &end, 10);
+		return !text.empty() && *end == '\0';
+	}
+
+	inline static bool ParseFloat(const std::string& text, float& value)
+	{
+		char* end = nullptr;
+		value = strtof(text.c_str(), &end);
+		return !text.empty() && *end == '\0';
+	}
+
+	inline static bool ParseVec3(const std::string& text, glm::vec3& value)
+	{
+		char* end = nullptr;
+		const char* current = text.c_str();
+
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			value[i] = strtof(current, &end);
+			if (end == current || *end != (i < 2 ? ',' : '\0'))
+				return false;
+
+			current = end + 1;
+		}
+
+		return true;
+	}
+
+	inline static bool ParseFormat(const std::string& text, ImageFormat& format)
+	{
+		if (text == "png")			format = ImageFormat::PNG;
+		else if (text == "png16")	format = ImageFormat::PNG16;
+		else if (text == "exr")		format = ImageFormat::EXR;
+		else if (text == "raw")		format = ImageFormat::Raw;
+		else						return false;
+
+		return true;
+	}
+}
+
+RenderServer::RenderServer(const ServerSpecification& specification)
+	: m_Specification(specification),
+	  m_ThreadPool(std::make_shared<ThreadPool>(specification.ThreadCount)),
+	  m_SceneCache(m_ThreadPool, specification.CacheCapacity),
+	  m_ImageWriter(2)
+{}
+
+RenderServer::~RenderServer()
+{
+	Stop();
+}
+
+bool RenderServer::Run()
+{
+	if (!m_Listener.Listen(m_Specification.SocketPath))
+	{
+		EPPO_ERROR("Could not listen on '{}', is another server running?", m_Specification.SocketPath);
+		return false;
+	}
+
+	m_Running = true;
+	m_Dispatcher = std::thread([this]() { DispatchLoop(); });
+
+	EPPO_INFO("Render server listening on '{}' with {} workers", m_Specification.SocketPath, m_ThreadPool->GetThreadCount());
+
+	while (m_Running)
+	{
+		LocalSocket socket = m_Listener.Accept();
+		if (!socket.IsValid())
+			continue;
+
+		ReapConnections(false);
+
+		auto connection = std::make_unique<Connection>();
+		connection->Socket = std::move(socket);
+
+		Connection& newConnection = *connection;
+		{
+			std::lock_guard<std::mutex> lock(m_ConnectionsMutex);
+			m_Connections.push_back(std::move(connection));
+		}
+
+		newConnection.Thread = std::thread([this, &newConnection]()
+		{
+			HandleConnection(newConnection);
+			newConnection.Finished = true;
+		});
+	}
+
+	// Running jobs stop after their current pass, images that are being written still get finished
+	m_Jobs.CancelAll();
+	m_Jobs.Stop();
+	m_Dispatcher.join();
+
+	ReapConnections(true);
+	m_ImageWriter.WaitForAll();
+	m_Listener.Close();
+
+	EPPO_INFO("Render server stopped");
+	return true;
+}
+
+void RenderServer::Stop()
+{
+	m_Running = false;
+	m_Listener.Shutdown();
+}
+
+void RenderServer::DispatchLoop()
+{
+	while (std::shared_ptr<RenderJob> job = m_Jobs.WaitForNext())
+	{
+		// A job that runs out of memory fails on its own instead of taking down the server
+		try
+		{
+			ExecuteJob(*job);
+		} catch (const std::bad_alloc&)
+		{
+			EPPO_ERROR("Job {} ran out of memory", job->Id);
+			m_Jobs.SetState(*job, JobState::Failed);
+		}
+	}
+}
+
+void RenderServer::ExecuteJob(RenderJob& job)
+{
+	// Jobs run one after the other, so the renderer of a scene is never used by two jobs at once
+	CachedScene& scene = *job.JobScene;
+	Renderer& renderer = *scene.SceneRenderer;
+
+	auto& settings = renderer.GetSettings();
+	settings.Accumulate = true;
+	settings.Bounces = job.Bounces;
+
+	Camera camera(job.FieldOfView, 0.1f, 10000.0f);
+	camera.OnResize(job.Width, job.Height);
+	camera.SetPosition(job.CameraPosition);
+	camera.SetDirection(job.CameraDirection);
+
+	RenderTarget target;
+	target.Resize(job.Width, job.Height);
+
+	std::vector<Renderer::RenderView> views = { { &camera, &target } };
+
+	while (job.SamplesDone < job.Samples)
+	{
+		if (job.CancelRequested || !m_Running)
+		{
+			m_Jobs.SetState(job, JobState::Cancelled);
+			return;
+		}
+
+		settings.SamplesPerPass = std::min(job.Samples - job.SamplesDone, Utils::MaxSamplesPerPass);
+		renderer.RenderViews(scene.Data, views);
+		job.SamplesDone += settings.SamplesPerPass;
+	}
+
+	if (job.OutputPath.empty())
+		job.OutputPath = "Output/job_" + std::to_string(job.Id) + ImageWriter::GetExtension(job.Format);
+
+	job.Output = m_ImageWriter.Write(target, job.OutputPath, job.Format);
+	m_Jobs.SetState(job, JobState::Writing);
+}
+
+void RenderServer::HandleConnection(Connection& connection)
+{
+	std::string line;
+	while (connection.Socket.ReadLine(line))
+	{
+		if (line.empty())
+			continue;
+
+		std::string reply = HandleCommand(line, connection.Socket);
+		if (!connection.Socket.Send(reply + '\n'))
+			break;
+
+		// Only after the reply, stopping shuts down every connection
+		if (line == "shutdown")
+			Stop();
+	}
+}
+
+std::string RenderServer::HandleCommand(const std::string& line, LocalSocket& socket)
+{
+	std::istringstream arguments(line);
+
+	std::string command;
+	arguments >> command;
+
+	if (command == "ping")
+		return "ok";
+
+	if (command == "has")
+	{
+		std::string text;
+		uint64_t hash;
+		if (!(arguments >> text) || !Utils::ParseHash(text, hash))
+			return "error expected a scene hash";
+
+		return m_SceneCache.Find(hash) ? "ok" : "missing";
+	}
+
+	if (command == "scene")
+	{
+		std::string text;
+		uint64_t size;
+		if (!(arguments >> text) || !Utils::ParseUInt(text, size) || size > Utils::MaxSceneSize)
+			return "error expected the scene size in bytes";
+
+		std::string sceneText;
+		if (!socket.ReadBytes((size_t)size, sceneText))
+			return "error connection closed during upload";
+
+		std::string error;
+		std::shared_ptr<CachedScene> scene = m_SceneCache.Insert(sceneText, error);
+		if (!scene)
+			return "error " + error;
+
+		return "ok " + Utils::FormatHash(scene->Hash);
+	}
+
+	if (command == "render")
+		return SubmitJob(arguments);
+
+	if (command == "status" || command == "wait" || command == "cancel")
+	{
+		std::string text;
+		uint64_t id;
+		if (!(arguments >> text) || !Utils::ParseUInt(text, id))
+			return "error expected a job id";
+
+		std::shared_ptr<RenderJob> job = m_Jobs.Find(id);
+		if (!job)
+			return "error unknown job " + text;
+
+		if (command == "cancel")
+		{
+			m_Jobs.Cancel(id);
+			return "ok";
+		}
+
+		JobState state = command == "wait" ? m_Jobs.WaitForCompletion(*job) : m_Jobs.GetState(*job);
+		if (command == "wait")
+			return std::string("ok ") + JobStateToString(state);
+
+		return std::string("ok ") + JobStateToString(state) + ' ' + std::to_string(job->SamplesDone.load()) + ' ' + std::to_string(job->Samples);
+	}
+
+	if (command == "stats")
+		return "ok " + std::to_string(m_SceneCache.GetSize()) + ' ' + std::to_string(m_Jobs.GetQueuedCount());
+
+	if (command == "shutdown")
+		return "ok";
+
+	return "error unknown command '" + command + "'";
+}
+
+std::string RenderServer::SubmitJob(std::istringstream& arguments)
+{
+	std::string hashText;
+	uint64_t hash;
+	if (!(arguments >> hashText) || !Utils::ParseHash(hashText, hash))
+		return "error expected a scene hash";
+
+	auto job = std::make_shared<RenderJob>();
+	job->JobScene = m_SceneCache.Find(hash);
+	if (!job->JobScene)
+		return "error unknown scene " + hashText;
+
+	std::string option;
+	while (arguments >> option)
+	{
+		size_t separator = option.find('=');
+		if (separator == std::string::npos)
+			return "error expected key=value, got '" + option + "'";
+
+		std::string key = option.substr(0, separator);
+		std::string value = option.substr(separator + 1);
+
+		bool valid = false;
+		if (key == "width")				valid = Utils::ParseUInt(value, job->Width, 1, Utils::MaxImageSize);
+		else if (key == "height")		valid = Utils::ParseUInt(value, job->Height, 1, Utils::MaxImageSize);
+		else if (key == "samples")		valid = Utils::ParseUInt(value, job->Samples, 1, UINT32_MAX);
+		else if (key == "bounces")		valid = Utils::ParseUInt(value, job->Bounces, 1, 8);
+		else if (key == "priority")		valid = Utils::ParseInt(value, job->Priority);
+		else if (key == "fov")			valid = Utils::ParseFloat(value, job->FieldOfView) && job->FieldOfView > 0.0f && job->FieldOfView < 180.0f;
+		else if (key == "position")		valid = Utils::ParseVec3(value, job->CameraPosition);
+		else if (key == "direction")	valid = Utils::ParseVec3(value, job->CameraDirection) && glm::dot(job->CameraDirection, job->CameraDirection) > 0.0f;
+		else if (key == "format")		valid = Utils::ParseFormat(value, job->Format);
+		else if (key == "output")
+		{
+			job->OutputPath = value;
+			valid = !value.empty();
+		} else
+		{
+			return "error unknown option '" + key + "'";
+		}
+
+		if (!valid)
+			return "error invalid value for '" + key + "'";
+	}
+
+	if ((uint64_t)job->Width * job->Height > Utils::MaxPixelCount)
+		return "error image too large";
+
+	job->CameraDirection = glm::normalize(job->CameraDirection);
+
+	return "ok " + std::to_string(m_Jobs.Submit(job));
+}
+
+void RenderServer::ReapConnections(bool all)
+{
+	std::lock_guard<std::mutex> lock(m_ConnectionsMutex);
+
+	for (auto it = m_Connections.begin(); it != m_Connections.end();)
+	{
+		Connection& connection = **it;
+		if (!all && !connection.Finished)
+		{
+			++it;
+			continue;
+		}
+
+		// Wakes up a connection that is waiting for its client
+		connection.Socket.Shutdown();
+		if (connection.Thread.joinable())
+			connection.Thread.join();
+
+		it = m_Connections.erase(it);
+	}
+}
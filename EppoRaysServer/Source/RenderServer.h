@@ -0,0 +1,85 @@
+#pragma once
+
+#include "JobQueue.h"
+#include "LocalSocket.h"
+#include "SceneCache.h"
+
+#include "RT/ImageWriter.h"
+#include "RT/ThreadPool.h"
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+struct ServerSpecification
+{
+	std::string SocketPath;
+	uint32_t CacheCapacity = 32;
+
+	// A thread count of 0 uses all hardware threads
+	uint32_t ThreadCount = 0;
+};
+
+// Long running render daemon. Clients talk to it over a local socket with a line based protocol,
+// every request gets a single line reply starting with "ok" or "error":
+//
+//   ping
+//   has <hash>                      ok | missing
+//   scene <size>\n<scene text>      ok <hash>, see SceneSerializer for the format
+//   render <hash> [key=value ...]   ok <job>, keys: width height samples bounces priority fov
+//                                   position=x,y,z direction=x,y,z output=<path> format=png|png16|exr|raw
+//   status <job>                    ok <state> <samples done> <samples>
+//   wait <job>                      ok <state>
+//   cancel <job>
+//   stats                           ok <cached scenes> <queued jobs>
+//   shutdown
+//
+// Hashes are 16 hex digits. Jobs run one at a time on all workers, so small jobs finish in order.
+class RenderServer
+{
+public:
+	explicit RenderServer(const ServerSpecification& specification);
+	~RenderServer();
+
+	// Blocks until Stop is called or a client asks for a shutdown
+	bool Run();
+
+	// Safe to call from a signal handler
+	void Stop();
+
+private:
+	struct Connection
+	{
+		LocalSocket Socket;
+		std::thread Thread;
+		std::atomic<bool> Finished = false;
+	};
+
+	void DispatchLoop();
+	void ExecuteJob(RenderJob& job);
+
+	void HandleConnection(Connection& connection);
+	std::string HandleCommand(const std::string& line, LocalSocket& socket);
+	std::string SubmitJob(std::istringstream& arguments);
+
+	void ReapConnections(bool all);
+
+private:
+	ServerSpecification m_Specification;
+
+	std::shared_ptr<ThreadPool> m_ThreadPool;
+	SceneCache m_SceneCache;
+	JobQueue m_Jobs;
+	ImageWriter m_ImageWriter;
+
+	LocalSocket m_Listener;
+	std::atomic<bool> m_Running = false;
+	std::thread m_Dispatcher;
+
+	std::list<std::unique_ptr<Connection>> m_Connections;
+	std::mutex m_ConnectionsMutex;
+};
@@ -0,0 +1,61 @@
+#include "SceneCache.h"
+
+#include "RT/SceneSerializer.h"
+
+#include <algorithm>
+
+SceneCache::SceneCache(std::shared_ptr<ThreadPool> threadPool, uint32_t capacity)
+	: m_ThreadPool(std::move(threadPool)), m_Capacity(std::max(capacity, 1u))
+{}
+
+std::shared_ptr<CachedScene> SceneCache::Find(uint64_t hash)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	auto it = m_Lookup.find(hash);
+	if (it == m_Lookup.end())
+		return nullptr;
+
+	m_Scenes.splice(m_Scenes.begin(), m_Scenes, it->second);
+	return *it->second;
+}
+
+std::shared_ptr<CachedScene> SceneCache::Insert(const std::string& text, std::string& error)
+{
+	// Parsing happens outside the lock, uploads of different scenes don't wait on each other
+	auto scene = std::make_shared<CachedScene>();
+	if (!SceneSerializer::Deserialize(text, scene->Data, error))
+		return nullptr;
+
+	// Hash the canonical form, formatting and comments don't make a scene different
+	scene->Hash = SceneSerializer::Hash(SceneSerializer::Serialize(scene->Data));
+
+	if (auto cached = Find(scene->Hash))
+		return cached;
+
+	scene->SceneRenderer = std::make_unique<Renderer>(m_ThreadPool);
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	// Someone else may have inserted the same scene while we were parsing
+	auto it = m_Lookup.find(scene->Hash);
+	if (it != m_Lookup.end())
+		return *it->second;
+
+	m_Scenes.push_front(scene);
+	m_Lookup[scene->Hash] = m_Scenes.begin();
+
+	while (m_Scenes.size() > m_Capacity)
+	{
+		m_Lookup.erase(m_Scenes.back()->Hash);
+		m_Scenes.pop_back();
+	}
+
+	return scene;
+}
+
+uint32_t SceneCache::GetSize()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return (uint32_t)m_Scenes.size();
+}
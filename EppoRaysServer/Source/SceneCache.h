@@ -0,0 +1,44 @@
+#pragma once
+
+#include "RT/Renderer.h"
+#include "RT/Scene.h"
+#include "RT/ThreadPool.h"
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+struct CachedScene
+{
+	uint64_t Hash = 0;
+	Scene Data;
+
+	// Every scene keeps its own renderer, so its hierarchy stays built between jobs
+	std::unique_ptr<Renderer> SceneRenderer;
+};
+
+// Parsed scenes by the hash of their canonical text, least recently used scenes are evicted first.
+// Jobs hold on to their scene, so evicting never pulls a scene from under a job.
+class SceneCache
+{
+public:
+	SceneCache(std::shared_ptr<ThreadPool> threadPool, uint32_t capacity);
+
+	std::shared_ptr<CachedScene> Find(uint64_t hash);
+
+	// Parses the scene, returns the cached copy when an identical scene is known already
+	std::shared_ptr<CachedScene> Insert(const std::string& text, std::string& error);
+
+	uint32_t GetSize();
+
+private:
+	std::shared_ptr<ThreadPool> m_ThreadPool;
+	uint32_t m_Capacity = 0;
+
+	// Most recently used first
+	std::list<std::shared_ptr<CachedScene>> m_Scenes;
+	std::unordered_map<uint64_t, std::list<std::shared_ptr<CachedScene>>::iterator> m_Lookup;
+	std::mutex m_Mutex;
+};
@@ -0,0 +1,55 @@
+project "EppoRaysServer"
+    kind "ConsoleApp"
+    language "C++"
+    cppdialect "C++17"
+    staticruntime "Off"
+
+    targetdir ("%{wks.location}/Bin/" .. OutputDir .. "/%{prj.name}")
+    objdir ("%{wks.location}/Bin-Int/" .. OutputDir .. "/%{prj.name}")
+
+    -- The tracer itself is shared with the app, only the GUI parts stay behind
+    files {
+        "Source/**.h",
+        "Source/**.cpp",
+        "%{wks.location}/EppoRays/Source/RT/**.h",
+        "%{wks.location}/EppoRays/Source/RT/**.cpp"
+    }
+
+    includedirs {
+        "Source",
+        "%{wks.location}/EppoRays/Source",
+        "%{wks.location}/EppoCore/EppoCore/Source",
+        "%{wks.location}/EppoCore/EppoCore/Vendor",
+
+        "%{IncludeDir.glm}",
+        "%{IncludeDir.imgui}",
+        "%{IncludeDir.spdlog}",
+        "%{IncludeDir.stb}"
+    }
+
+    links {
+        "EppoCore"
+    }
+
+    filter "system:linux"
+        links {
+            "glfw",
+            "glad",
+            "imgui",
+            "spdlog",
+            "GLU",
+            "GL",
+            "X11",
+            "dl",
+            "pthread"
+        }
+
+    filter "configurations:Debug"
+        defines "EPPO_DEBUG"
+        runtime "Debug"
+        symbols "On"
+    
+    filter "configurations:Release"
+        defines "EPPO_RELEASE"
+        runtime "Release"
+        optimize "On"
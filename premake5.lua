@@ -18,4 +18,5 @@ workspace "EppoRays"
     
     group "App"
         include "EppoRays"
+        include "EppoRaysServer"
     group ""
\ No newline at end of file